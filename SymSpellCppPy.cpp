@@ -8,6 +8,15 @@
 
 namespace py = pybind11;
 
+// Chars of a bytes-like object (bytes, bytearray, memoryview, ...), used in place.
+static py::buffer_info RequestText(const py::buffer &buffer)
+{
+     py::buffer_info info = buffer.request();
+     if (info.ndim != 1 || info.itemsize != 1 || info.strides[0] != 1)
+          throw std::invalid_argument("expected a contiguous buffer of bytes");
+     return info;
+}
+
 PYBIND11_MODULE(SymSpellCppPy, m)
 {
      m.doc() = R"pbdoc(
@@ -20,7 +29,9 @@ PYBIND11_MODULE(SymSpellCppPy, m)
            Info
            SuggestItem
            Verbosity
+           SuggestionStage
            SymSpell
+           WordSegmentationStream
     )pbdoc";
 
      py::class_<symspellcpppy::Info>(m, "Info")
@@ -126,137 +137,400 @@ PYBIND11_MODULE(SymSpellCppPy, m)
      )pbdoc")
          .export_values();
 
+     py::enum_<DeleteHasher>(m, "DeleteHasher")
+         .value("FNV32", DeleteHasher::Fnv32, R"pbdoc(
+          32-bit FNV-1a reduced by compact_level, the original SymSpell bucket key: unrelated deletes may share a bucket.
+     )pbdoc")
+         .value("FNV64", DeleteHasher::Fnv64, R"pbdoc(
+          64-bit FNV-1a, compact_level is ignored.
+     )pbdoc")
+         .value("WYHASH", DeleteHasher::WyHash, R"pbdoc(
+          64-bit wyhash, compact_level is ignored.
+     )pbdoc")
+         .export_values();
+
+     py::class_<SuggestionStage, std::shared_ptr<SuggestionStage>>(m, "SuggestionStage", R"pbdoc(
+        Staging area for the deletes of many new dictionary entries: add entries with
+        create_dictionary_entry(key, count, staging), then apply them all with one commit_staged(staging).
+        Counts take effect immediately, the new words are suggested once the stage is committed.
+    )pbdoc")
+         .def(py::init<int>(), R"pbdoc(
+            Constructor of SuggestionStage, sized for about initial_capacity staged deletes.
+        )pbdoc",
+              py::arg("initial_capacity") = 16384)
+         .def("delete_count", &SuggestionStage::DeleteCount, R"pbdoc(
+            Number of distinct deletes staged.
+        )pbdoc")
+         .def("node_count", &SuggestionStage::NodeCount, R"pbdoc(
+            Number of (delete, word) pairs staged.
+        )pbdoc")
+         .def("clear", &SuggestionStage::Clear, R"pbdoc(
+            Drop everything staged.
+        )pbdoc");
+
      py::class_<symspellcpppy::SymSpell>(m, "SymSpell", R"pbdoc(
         SymSpell is a class that provides fast and accurate spelling correction using Symmetric Delete spelling correction algorithm.
+        An instance can be shared between threads: lookups run concurrently, and a call that changes the dictionary
+        (adding, deleting or loading entries, compact_index, load_index, load_pickle) waits for the running lookups
+        and holds back new ones until it is done. Every call releases the GIL while it runs.
     )pbdoc")
-         .def(py::init<int, int, int, int, unsigned char>(), "SymSpell builder options",
+         .def(py::init<int, int, int, int, unsigned char, bool, DeleteHasher>(), "SymSpell builder options",
               py::arg("max_dictionary_edit_distance") = DEFAULT_MAX_EDIT_DISTANCE,
               py::arg("prefix_length") = DEFAULT_PREFIX_LENGTH,
               py::arg("count_threshold") = DEFAULT_COUNT_THRESHOLD,
               py::arg("initial_capacity") = DEFAULT_INITIAL_CAPACITY,
-              py::arg("compact_level") = DEFAULT_COMPACT_LEVEL)
+              py::arg("compact_level") = DEFAULT_COMPACT_LEVEL,
+              py::arg("frozen_index") = false,
+              py::arg("delete_hasher") = DeleteHasher::Fnv32)
+         .def("delete_hasher", &symspellcpppy::SymSpell::Hasher, R"pbdoc(
+        Retrieves the hash function of the delete buckets.
+    )pbdoc",
+              py::call_guard<py::gil_scoped_release>())
          .def("word_count", &symspellcpppy::SymSpell::WordCount, R"pbdoc(
         Retrieves the total number of words in the dictionary.
-    )pbdoc")
+    )pbdoc",
+              py::call_guard<py::gil_scoped_release>())
          .def("max_length", &symspellcpppy::SymSpell::MaxLength, R"pbdoc(
         Retrieves the maximum length of words in the dictionary.
-    )pbdoc")
+    )pbdoc",
+              py::call_guard<py::gil_scoped_release>())
          .def("entry_count", &symspellcpppy::SymSpell::EntryCount, R"pbdoc(
         Retrieves the total number of delete words formed in the dictionary.
-    )pbdoc")
+    )pbdoc",
+              py::call_guard<py::gil_scoped_release>())
          .def("count_threshold", &symspellcpppy::SymSpell::CountThreshold, R"pbdoc(
         Retrieves the frequency threshold to be considered as a valid word for spelling correction.
-    )pbdoc")
+    )pbdoc",
+              py::call_guard<py::gil_scoped_release>())
          .def(
              "create_dictionary_entry", [](symspellcpppy::SymSpell &sym, const xstring &key, int64_t count)
              {
-          auto staging = std::make_shared<SuggestionStage>(128);
-          sym.CreateDictionaryEntry(Helpers::string_lower(key), count, staging);
-          sym.CommitStaged(staging);
-          return sym.EntryCount() > 0; },
+          sym.CreateDictionaryEntry(Helpers::string_lower(key), count, nullptr);
+          return sym.HasEntries(); },
              R"pbdoc(
                 Create or update an entry in the dictionary.
     )pbdoc",
+             py::call_guard<py::gil_scoped_release>(),
              py::arg("key"), py::arg("count"))
+         .def(
+             "create_dictionary_entry", [](symspellcpppy::SymSpell &sym, const xstring &key, int64_t count,
+                                           const std::shared_ptr<SuggestionStage> &staging)
+             { return sym.CreateDictionaryEntry(Helpers::string_lower(key), count, staging); },
+             R"pbdoc(
+                Create or update an entry in the dictionary, staging the deletes of a new word in staging.
+                The word is suggested after commit_staged(staging). Returns True when the key became a new word.
+    )pbdoc",
+             py::call_guard<py::gil_scoped_release>(),
+             py::arg("key"), py::arg("count"), py::arg("staging"))
+         .def("commit_staged", &symspellcpppy::SymSpell::CommitStaged, R"pbdoc(
+        Apply the deletes of a SuggestionStage to the dictionary. The cost is the number of staged deletes.
+    )pbdoc",
+              py::call_guard<py::gil_scoped_release>(),
+              py::arg("staging"))
+         .def(
+             "add_entries", [](symspellcpppy::SymSpell &sym, const std::vector<xstring> &terms, const std::vector<int64_t> &counts,
+                               int threads)
+             {
+                     if (terms.size() != counts.size())
+                         throw std::invalid_argument("terms and counts differ in length");
+                     std::vector<std::pair<xstring, int64_t>> entries;
+                     entries.reserve(terms.size());
+                     for (size_t i = 0; i < terms.size(); i++)
+                         entries.emplace_back(Helpers::string_lower(terms[i]), counts[i]);
+                     py::gil_scoped_release release;
+                     return sym.CreateDictionaryEntries(entries, threads); },
+             R"pbdoc(
+        Create or update the entries terms[i] with counts[i] (two sequences of equal length) in one pass, as
+        create_dictionary_entries. Returns the number of new dictionary words.
+    )pbdoc",
+              py::arg("terms"), py::arg("counts"), py::arg("threads") = 1)
          .def("delete_dictionary_entry", &symspellcpppy::SymSpell::DeleteDictionaryEntry, R"pbdoc(
         Deletes a word from the dictionary and updates internal representation accordingly.
+        The term stays interned, so memory is not returned; adding it again reuses its id.
     )pbdoc",
+              py::call_guard<py::gil_scoped_release>(),
               py::arg("key"))
-         .def("load_bigram_dictionary", py::overload_cast<const std::string &, int, int, xchar>(&symspellcpppy::SymSpell::LoadBigramDictionary), R"pbdoc(
+         .def("delete_dictionary_entries", &symspellcpppy::SymSpell::DeleteDictionaryEntries, R"pbdoc(
+        Deletes many words from the dictionary, visiting every affected delete bucket once.
+        Returns the number of keys that were dictionary words.
+    )pbdoc",
+              py::call_guard<py::gil_scoped_release>(),
+              py::arg("keys"))
+         .def("compact_index", &symspellcpppy::SymSpell::CompactIndex, R"pbdoc(
+        Rebuilds a frozen or loaded index without the words deleted since it was built.
+    )pbdoc",
+              py::call_guard<py::gil_scoped_release>())
+         .def(
+             "load_bigram_dictionary", [](symspellcpppy::SymSpell &sym, const std::string &corpus, int term_index,
+                                          int count_index, xchar separator)
+             { return sym.LoadBigramDictionary(corpus, term_index, count_index, separator); },
+             R"pbdoc(
         Load multiple dictionary entries from a file of word/frequency count pairs.
     )pbdoc",
+              py::call_guard<py::gil_scoped_release>(),
               py::arg("corpus"), py::arg("term_index"), py::arg("count_index"), py::arg("separator") = DEFAULT_SEPARATOR_CHAR)
-         .def("load_dictionary", py::overload_cast<const std::string &, int, int, xchar>(&symspellcpppy::SymSpell::LoadDictionary), R"pbdoc(
+         .def(
+             "load_dictionary", [](symspellcpppy::SymSpell &sym, const std::string &corpus, int term_index,
+                                   int count_index, xchar separator, int threads)
+             { return sym.LoadDictionary(corpus, term_index, count_index, separator, threads); },
+             R"pbdoc(
         Load multiple dictionary entries from a file of word/frequency count pairs.
+        The deletes are generated on the given number of threads (0 uses every core);
+        the resulting dictionary is the same for any value.
     )pbdoc",
-              py::arg("corpus"), py::arg("term_index"), py::arg("count_index"), py::arg("separator") = DEFAULT_SEPARATOR_CHAR)
-         .def("create_dictionary", py::overload_cast<const std::string &>(&symspellcpppy::SymSpell::CreateDictionary), R"pbdoc(
+              py::call_guard<py::gil_scoped_release>(),
+              py::arg("corpus"), py::arg("term_index"), py::arg("count_index"), py::arg("separator") = DEFAULT_SEPARATOR_CHAR,
+              py::arg("threads") = 1)
+         .def(
+             "load_dictionary_buffer", [](symspellcpppy::SymSpell &sym, const py::buffer &buffer, int term_index,
+                                          int count_index, xchar separator, int threads)
+             {
+                     py::buffer_info text = RequestText(buffer);
+                     py::gil_scoped_release release;
+                     return sym.LoadDictionaryBuffer(static_cast<const xchar *>(text.ptr), text.size, term_index,
+                                                     count_index, separator, threads); },
+             R"pbdoc(
+        Load multiple dictionary entries from the contents of a dictionary file in memory, any bytes-like
+        object (bytes, bytearray, memoryview, mmap). The buffer is parsed in place without a copy.
+    )pbdoc",
+              py::arg("buffer"), py::arg("term_index"), py::arg("count_index"), py::arg("separator") = DEFAULT_SEPARATOR_CHAR,
+              py::arg("threads") = 1)
+         .def(
+             "load_bigram_dictionary_buffer", [](symspellcpppy::SymSpell &sym, const py::buffer &buffer, int term_index,
+                                                 int count_index, xchar separator)
+             {
+                     py::buffer_info text = RequestText(buffer);
+                     py::gil_scoped_release release;
+                     return sym.LoadBigramDictionaryBuffer(static_cast<const xchar *>(text.ptr), text.size, term_index,
+                                                           count_index, separator); },
+             R"pbdoc(
+        Load bigrams from the contents of a bigram file in memory, any bytes-like object. The buffer is parsed
+        in place without a copy.
+    )pbdoc",
+              py::arg("buffer"), py::arg("term_index"), py::arg("count_index"), py::arg("separator") = DEFAULT_SEPARATOR_CHAR)
+         .def(
+             "create_dictionary_entries", [](symspellcpppy::SymSpell &sym, const py::iterable &entries, int threads)
+             {
+                     std::vector<std::pair<xstring, int64_t>> terms;
+                     for (const py::handle &entry : entries)
+                     {
+                         auto term = entry.cast<std::pair<xstring, int64_t>>();
+                         terms.emplace_back(Helpers::string_lower(term.first), term.second);
+                     }
+                     py::gil_scoped_release release;
+                     return sym.CreateDictionaryEntries(terms, threads); },
+             R"pbdoc(
+        Create or update many entries from an iterable of (term, count) pairs, e.g. dict.items(). The deletes
+        of all new words are generated in one pass on the given number of threads (0 uses every core).
+        Returns the number of new dictionary words.
+    )pbdoc",
+              py::arg("entries"), py::arg("threads") = 1)
+         .def("create_dictionary", py::overload_cast<const std::string &, int>(&symspellcpppy::SymSpell::CreateDictionary), R"pbdoc(
         Load multiple dictionary words from a file containing plain text.
+        The deletes are generated on the given number of threads (0 uses every core);
+        the resulting dictionary is the same for any value.
     )pbdoc",
-              py::arg("corpus"))
+              py::call_guard<py::gil_scoped_release>(),
+              py::arg("corpus"), py::arg("threads") = 1)
          .def("purge_below_threshold_words", &symspellcpppy::SymSpell::PurgeBelowThresholdWords,
-              "Remove all below threshold words from the dictionary.")
-         .def("lookup", py::overload_cast<const xstring &, symspellcpppy::Verbosity>(&symspellcpppy::SymSpell::Lookup), R"pbdoc(
+              "Remove all below threshold words from the dictionary.",
+              py::call_guard<py::gil_scoped_release>())
+         .def("lookup", py::overload_cast<const xstring &, symspellcpppy::Verbosity>(&symspellcpppy::SymSpell::Lookup, py::const_), R"pbdoc(
         Find suggested spellings for a given input word, using the maximum
         edit distance specified during construction of the SymSpell dictionary.
      )pbdoc",
+              py::call_guard<py::gil_scoped_release>(),
               py::arg("input"),
               py::arg("verbosity"))
-         .def("lookup", py::overload_cast<const xstring &, symspellcpppy::Verbosity, int>(&symspellcpppy::SymSpell::Lookup), R"pbdoc(
+         .def("lookup", py::overload_cast<const xstring &, symspellcpppy::Verbosity, int>(&symspellcpppy::SymSpell::Lookup, py::const_), R"pbdoc(
         Find suggested spellings for a given input word, using the maximum
         edit distance provided to the function.
      )pbdoc",
+              py::call_guard<py::gil_scoped_release>(),
               py::arg("input"),
               py::arg("verbosity"),
               py::arg("max_edit_distance"))
-         .def("lookup", py::overload_cast<const xstring &, symspellcpppy::Verbosity, int, bool>(&symspellcpppy::SymSpell::Lookup), R"pbdoc(
+         .def("lookup", py::overload_cast<const xstring &, symspellcpppy::Verbosity, int, bool>(&symspellcpppy::SymSpell::Lookup, py::const_), R"pbdoc(
         Find suggested spellings for a given input word, using the maximum\
         edit distance provided to the function and include input word in suggestions if no words within edit distance found.
      )pbdoc",
+              py::call_guard<py::gil_scoped_release>(),
               py::arg("input"),
               py::arg("verbosity"),
               py::arg("max_edit_distance"),
               py::arg("include_unknown"))
-         .def("lookup", py::overload_cast<const xstring &, symspellcpppy::Verbosity, int, bool, bool>(&symspellcpppy::SymSpell::Lookup), R"pbdoc(
+         .def("lookup", py::overload_cast<const xstring &, symspellcpppy::Verbosity, int, bool, bool>(&symspellcpppy::SymSpell::Lookup, py::const_), R"pbdoc(
         Find suggested spellings for a given input word, using the maximum
         edit distance provided to the function and include input word in suggestions if no words within edit distance found & preserve transfer casing.
      )pbdoc",
+              py::call_guard<py::gil_scoped_release>(),
               py::arg("input"),
               py::arg("verbosity"),
               py::arg("max_edit_distance") = DEFAULT_MAX_EDIT_DISTANCE,
               py::arg("include_unknown") = false,
               py::arg("transfer_casing") = false)
-         .def("lookup_compound", py::overload_cast<const xstring &>(&symspellcpppy::SymSpell::LookupCompound),
+         .def("lookup_compound", py::overload_cast<const xstring &>(&symspellcpppy::SymSpell::LookupCompound, py::const_),
               R"pbdoc(
         LookupCompound supports compound-aware automatic spelling correction of multi-word input strings with three cases:
           1. Mistakenly inserted space into a correct word led to two incorrect terms.
           2. Mistakenly omitted space between two correct words led to one incorrect combined term.
           3. Multiple independent input terms with/without spelling errors.
     )pbdoc",
+              py::call_guard<py::gil_scoped_release>(),
               py::arg("input"))
-         .def("lookup_compound", py::overload_cast<const xstring &, int>(&symspellcpppy::SymSpell::LookupCompound),
+         .def("lookup_compound", py::overload_cast<const xstring &, int>(&symspellcpppy::SymSpell::LookupCompound, py::const_),
               R"pbdoc(
         LookupCompound supports compound-aware automatic spelling correction of multi-word input strings with three cases:
           1. Mistakenly inserted space into a correct word led to two incorrect terms.
           2. Mistakenly omitted space between two correct words led to one incorrect combined term.
           3. Multiple independent input terms with/without spelling errors.
     )pbdoc",
+              py::call_guard<py::gil_scoped_release>(),
               py::arg("input"),
               py::arg("max_edit_distance"))
-         .def("lookup_compound", py::overload_cast<const xstring &, int, bool>(&symspellcpppy::SymSpell::LookupCompound),
+         .def("lookup_compound", py::overload_cast<const xstring &, int, bool>(&symspellcpppy::SymSpell::LookupCompound, py::const_),
               R"pbdoc(
         LookupCompound supports compound-aware automatic spelling correction of multi-word input strings with three cases:
           1. Mistakenly inserted space into a correct word led to two incorrect terms.
           2. Mistakenly omitted space between two correct words led to one incorrect combined term.
           3. Multiple independent input terms with/without spelling errors.
     )pbdoc",
+              py::call_guard<py::gil_scoped_release>(),
               py::arg("input"),
               py::arg("max_edit_distance"),
               py::arg("transfer_casing"))
-         .def("word_segmentation", py::overload_cast<const xstring &>(&symspellcpppy::SymSpell::WordSegmentation),
+         .def("word_segmentation", py::overload_cast<const xstring &>(&symspellcpppy::SymSpell::WordSegmentation, py::const_),
               R"pbdoc(
         WordSegmentation divides a string into words by inserting missing spaces at the appropriate positions.
         Misspelled words are corrected and do not affect segmentation.
         Existing spaces are allowed and considered for optimum segmentation.
     )pbdoc",
+              py::call_guard<py::gil_scoped_release>(),
               py::arg("input"))
-         .def("word_segmentation", py::overload_cast<const xstring &, int>(&symspellcpppy::SymSpell::WordSegmentation),
+         .def("word_segmentation", py::overload_cast<const xstring &, int>(&symspellcpppy::SymSpell::WordSegmentation, py::const_),
               R"pbdoc(
         WordSegmentation divides a string into words by inserting missing spaces at the appropriate positions.
         Misspelled words are corrected and do not affect segmentation.
         Existing spaces are allowed and considered for optimum segmentation.
     )pbdoc",
+              py::call_guard<py::gil_scoped_release>(),
               py::arg("input"),
               py::arg("max_edit_distance"))
-         .def("word_segmentation", py::overload_cast<const xstring &, int, int>(&symspellcpppy::SymSpell::WordSegmentation),
+         .def("word_segmentation", py::overload_cast<const xstring &, int, int>(&symspellcpppy::SymSpell::WordSegmentation, py::const_),
               R"pbdoc(
         WordSegmentation divides a string into words by inserting missing spaces at the appropriate positions.
         Misspelled words are corrected and do not affect segmentation.
         Existing spaces are allowed and considered for optimum segmentation.
     )pbdoc",
+              py::call_guard<py::gil_scoped_release>(),
               py::arg("input"),
               py::arg("max_edit_distance"),
               py::arg("max_segmentation_word_length"))
+         .def(
+             "word_segmentation_top_k", [](symspellcpppy::SymSpell &sym, const xstring &input, int k,
+                                           int max_edit_distance, int max_segmentation_word_length)
+             {
+                     if (max_segmentation_word_length <= 0)
+                         max_segmentation_word_length = sym.MaxLength();
+                     return sym.WordSegmentationTopK(input, k, max_edit_distance, max_segmentation_word_length); },
+             R"pbdoc(
+        The k best word segmentations of the input, for reranking. The first is the result of word_segmentation,
+        the others follow ordered by edit distance (not counting the inserted spaces), then by probability.
+        Every part of the input is looked up once whatever k is, so k=5 costs little more than k=1.
+        A max_segmentation_word_length of 0 uses the longest dictionary word.
+    )pbdoc",
+             py::call_guard<py::gil_scoped_release>(),
+             py::arg("input"),
+             py::arg("k"),
+             py::arg("max_edit_distance") = DEFAULT_MAX_EDIT_DISTANCE,
+             py::arg("max_segmentation_word_length") = 0)
+         .def(
+             "word_segmentation_bigrams", [](symspellcpppy::SymSpell &sym, const xstring &input,
+                                             int max_edit_distance, int max_segmentation_word_length)
+             {
+                     if (max_segmentation_word_length <= 0)
+                         max_segmentation_word_length = sym.MaxLength();
+                     return sym.WordSegmentationBigrams(input, max_edit_distance, max_segmentation_word_length); },
+             R"pbdoc(
+        Word segmentation scoring every word by its bigram probability given the previous word, using the
+        bigrams of load_bigram_dictionary (Viterbi over the last word). Segmentations are compared by edit
+        distance without the inserted spaces, then by probability. A max_segmentation_word_length of 0 uses
+        the longest dictionary word.
+    )pbdoc",
+             py::call_guard<py::gil_scoped_release>(),
+             py::arg("input"),
+             py::arg("max_edit_distance") = DEFAULT_MAX_EDIT_DISTANCE,
+             py::arg("max_segmentation_word_length") = 0)
+         .def("bigram_count", &symspellcpppy::SymSpell::BigramCount, R"pbdoc(
+        Count of the bigram "word1 word2" in the bigram dictionary (0 when it is unknown).
+    )pbdoc",
+              py::call_guard<py::gil_scoped_release>(),
+              py::arg("word1"), py::arg("word2"))
+         .def("lookup_batch", &symspellcpppy::SymSpell::LookupBatch, R"pbdoc(
+        Find suggested spellings for a list of input words at once. The words are spread over a pool of
+        native threads (threads=0 uses every core) and the results are returned in input order.
+     )pbdoc",
+              py::call_guard<py::gil_scoped_release>(),
+              py::arg("inputs"),
+              py::arg("verbosity"),
+              py::arg("max_edit_distance") = DEFAULT_MAX_EDIT_DISTANCE,
+              py::arg("include_unknown") = false,
+              py::arg("transfer_casing") = false,
+              py::arg("threads") = 0)
+         .def("lookup_compound_batch", &symspellcpppy::SymSpell::LookupCompoundBatch, R"pbdoc(
+        Run lookup_compound on a list of multi-word input strings at once, spread over a pool of
+        native threads (threads=0 uses every core). The results are returned in input order.
+     )pbdoc",
+              py::call_guard<py::gil_scoped_release>(),
+              py::arg("inputs"),
+              py::arg("max_edit_distance") = DEFAULT_MAX_EDIT_DISTANCE,
+              py::arg("transfer_casing") = false,
+              py::arg("threads") = 0)
+         .def(
+             "word_segmentation_batch", [](symspellcpppy::SymSpell &sym, const std::vector<xstring> &inputs,
+                                           int max_edit_distance, int max_segmentation_word_length, int threads)
+             {
+                     if (max_segmentation_word_length <= 0)
+                         max_segmentation_word_length = sym.MaxLength();
+                     return sym.WordSegmentationBatch(inputs, max_edit_distance, max_segmentation_word_length, threads); },
+             R"pbdoc(
+        Run word_segmentation on a list of input strings at once, spread over a pool of native threads
+        (threads=0 uses every core). A max_segmentation_word_length of 0 uses the longest dictionary word.
+        The results are returned in input order.
+    )pbdoc",
+             py::call_guard<py::gil_scoped_release>(),
+             py::arg("inputs"),
+             py::arg("max_edit_distance") = DEFAULT_MAX_EDIT_DISTANCE,
+             py::arg("max_segmentation_word_length") = 0,
+             py::arg("threads") = 0)
+         .def("enable_lookup_cache", &symspellcpppy::SymSpell::EnableLookupCache, R"pbdoc(
+        Cache the results of lookup, and of the lookups made by lookup_compound and word_segmentation.
+        The cache keeps at most capacity results, evicting the least recently used ones, and is cleared
+        whenever the dictionary changes. A capacity of 0 disables the cache.
+    )pbdoc",
+              py::call_guard<py::gil_scoped_release>(),
+              py::arg("capacity"))
+         .def("clear_lookup_cache", &symspellcpppy::SymSpell::ClearLookupCache, R"pbdoc(
+        Drop all cached lookup results and reset the hit and miss counters.
+    )pbdoc",
+              py::call_guard<py::gil_scoped_release>())
+         .def(
+             "lookup_cache_stats", [](const symspellcpppy::SymSpell &sym)
+             {
+                     LookupCache<std::vector<symspellcpppy::SuggestItem>>::Stats stats;
+                     {
+                         py::gil_scoped_release release;
+                         stats = sym.LookupCacheStats();
+                     }
+                     py::dict result;
+                     result["hits"] = stats.hits;
+                     result["misses"] = stats.misses;
+                     result["size"] = stats.size;
+                     result["capacity"] = stats.capacity;
+                     return result; },
+             R"pbdoc(
+        Counters of the lookup cache as a dict with hits, misses, size and capacity (all 0 when disabled).
+    )pbdoc")
          .def(
              "save_pickle", [](symspellcpppy::SymSpell &sym, const std::string &filepath)
              {
@@ -268,6 +542,7 @@ PYBIND11_MODULE(SymSpellCppPy, m)
                          throw std::invalid_argument("Cannot save to file: " + filepath);
                      } },
              "Save internal representation to file",
+             py::call_guard<py::gil_scoped_release>(),
              py::arg("filepath"))
          .def(
              "load_pickle", [](symspellcpppy::SymSpell &sym, const std::string &filepath)
@@ -280,13 +555,42 @@ PYBIND11_MODULE(SymSpellCppPy, m)
                          throw std::invalid_argument("Unable to load file from filepath: " + filepath);
                      } },
              "Load internal representation from file",
+             py::call_guard<py::gil_scoped_release>(),
+             py::arg("filepath"))
+         .def(
+             "save_index", [](symspellcpppy::SymSpell &sym, const std::string &filepath)
+             {
+                     if (!sym.SaveIndex(filepath)) {
+                         throw std::invalid_argument("Cannot save to file: " + filepath);
+                     } },
+             R"pbdoc(
+        Save the dictionary, delete index and bigrams as a memory mappable index image.
+    )pbdoc",
+             py::call_guard<py::gil_scoped_release>(),
+             py::arg("filepath"))
+         .def(
+             "load_index", [](symspellcpppy::SymSpell &sym, const std::string &filepath)
+             {
+                     if (!sym.LoadIndex(filepath)) {
+                         throw std::invalid_argument("Unable to load file from filepath: " + filepath);
+                     } },
+             R"pbdoc(
+        Memory map an index image written by save_index. Lookups read the mapped file directly,
+        so several processes mapping the same image share its pages. The edit distance, prefix length,
+        count threshold and compact level of the image replace those of this instance. Raises ValueError
+        when the file cannot be opened or is not a valid index image; the dictionary is then left unchanged.
+    )pbdoc",
+             py::call_guard<py::gil_scoped_release>(),
              py::arg("filepath"))
          .def(
              "save_pickle_bytes", [](symspellcpppy::SymSpell &sym)
              {
                     std::ostringstream binary_stream(std::ios::out | std::ios::binary);
-                    cereal::BinaryOutputArchive ar(binary_stream);
-                    ar(sym);
+                    {
+                        py::gil_scoped_release release;
+                        cereal::BinaryOutputArchive ar(binary_stream);
+                        ar(sym);
+                    }
 
                     return py::bytes(binary_stream.str()); },
              "Save internal representation to bytes")
@@ -306,8 +610,45 @@ PYBIND11_MODULE(SymSpellCppPy, m)
                     std::string const bytes_str(reinterpret_cast<char*>(buff.ptr), buff.size * buff.itemsize);
                     std::istringstream binary_stream(bytes_str, std::ios::in | std::ios::binary);
 
+                    py::gil_scoped_release release;
                     cereal::BinaryInputArchive ar(binary_stream);
                     ar(sym); },
              "Load internal representation from buffers, such as 'bytes' and 'memoryview'",
              py::arg("bytes"));
+
+     py::class_<symspellcpppy::WordSegmentationStream>(m, "WordSegmentationStream", R"pbdoc(
+        Word segmentation of text that arrives in chunks, such as log streams or OCR page dumps. push returns the
+        words that later input can no longer change; finish ends the text and returns the rest. Joined together,
+        the returned pieces are the result of word_segmentation on the whole text. Only the uncommitted tail of
+        the text is kept in memory.
+    )pbdoc")
+         .def(py::init([](const symspellcpppy::SymSpell &sym, int max_edit_distance, int max_segmentation_word_length)
+                       { return new symspellcpppy::WordSegmentationStream(
+                             sym, max_edit_distance,
+                             max_segmentation_word_length > 0 ? max_segmentation_word_length : sym.MaxLength()); }),
+              R"pbdoc(
+            Create a stream segmenting with the given options; a max_segmentation_word_length of 0 uses the
+            longest dictionary word. The SymSpell instance is kept alive by the stream; changing its dictionary
+            between two chunks changes the words that are still open.
+        )pbdoc",
+              py::keep_alive<1, 2>(),
+              py::arg("sym_spell"),
+              py::arg("max_edit_distance") = DEFAULT_MAX_EDIT_DISTANCE,
+              py::arg("max_segmentation_word_length") = 0)
+         .def("push", &symspellcpppy::WordSegmentationStream::Push, R"pbdoc(
+            Append the next chunk of text. Returns an Info with the newly committed segmented and corrected text,
+            to be appended to the previous pieces, and the distance and log probability they add.
+        )pbdoc",
+              py::call_guard<py::gil_scoped_release>(),
+              py::arg("chunk"))
+         .def("finish", &symspellcpppy::WordSegmentationStream::Finish, R"pbdoc(
+            End the text and return the remaining words as push does. The next push starts a new text.
+        )pbdoc",
+              py::call_guard<py::gil_scoped_release>())
+         .def("distance", &symspellcpppy::WordSegmentationStream::Distance, R"pbdoc(
+            Edit distance sum of the words committed so far (of the whole text after finish).
+        )pbdoc")
+         .def("probability", &symspellcpppy::WordSegmentationStream::Probability, R"pbdoc(
+            Log probability sum of the words committed so far (of the whole text after finish).
+        )pbdoc");
 }
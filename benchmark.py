@@ -5,7 +5,7 @@
 """
 
 from symspellpy import SymSpell as SymSpellPy, Verbosity as VerbosityPy
-from SymSpellCppPy import SymSpell as SymSpellCpp, Verbosity as VerbosityCpp
+from SymSpellCppPy import SymSpell as SymSpellCpp, Verbosity as VerbosityCpp, DeleteHasher
 import pytest
 import os
 
@@ -226,3 +226,71 @@ def test_lookup_compund_transfer_casing_symspellcpppy(benchmark):
                   "who couldn't read in sixth grade AND inspired him")
     results = benchmark(sym_spell.lookup_compound, typo, 2, transfer_casing=True)
     assert (results[0].term == correction)
+
+def new_terms(round_index, count=1000):
+    letters = "abcdefghijklmnopqrstuvwxyz"
+    return ["".join(letters[(i * 7 + j * 13 + round_index) % 26] for j in range(4 + i % 8)) + str(round_index)
+            for i in range(count)]
+
+@pytest.mark.benchmark(
+    group="add_entries",
+    min_rounds=5,
+    disable_gc=True,
+    warmup=False
+)
+def test_add_entries_one_by_one_symspellpy(benchmark):
+    sym_spell = SymSpellPy(max_dictionary_edit_distance=2, prefix_length=7)
+    sym_spell.load_dictionary(dict_path, term_index=0, count_index=1, separator=" ")
+    rounds = iter(range(1000))
+
+    def add():
+        for term in new_terms(next(rounds)):
+            sym_spell.create_dictionary_entry(term, 5)
+    benchmark(add)
+    assert (sym_spell.lookup("abcd", VerbosityPy.TOP, 2))
+
+@pytest.mark.benchmark(
+    group="add_entries",
+    min_rounds=5,
+    disable_gc=True,
+    warmup=False
+)
+def test_add_entries_one_by_one_symspellcpppy(benchmark):
+    sym_spell = SymSpellCpp(max_dictionary_edit_distance=2, prefix_length=7)
+    sym_spell.load_dictionary(dict_path, term_index=0, count_index=1, separator=" ")
+    rounds = iter(range(1000))
+
+    def add():
+        for term in new_terms(next(rounds)):
+            sym_spell.create_dictionary_entry(term, 5)
+    benchmark(add)
+    assert (sym_spell.lookup("abcd", VerbosityCpp.TOP, 2))
+
+
+distinct_deletes = {}
+
+@pytest.mark.benchmark(
+    group="delete_hasher",
+    min_rounds=5,
+    disable_gc=True,
+    warmup=False
+)
+@pytest.mark.parametrize("hasher", [DeleteHasher.FNV32, DeleteHasher.FNV64, DeleteHasher.WYHASH])
+@pytest.mark.parametrize("compact_level", [0, 5, 10, 16])
+def test_delete_hasher_symspellcpppy(benchmark, hasher, compact_level):
+    # collision rate: share of the distinct deletes that had to share a bucket with another delete
+    if "count" not in distinct_deletes:
+        reference = SymSpellCpp(max_dictionary_edit_distance=2, prefix_length=7, delete_hasher=DeleteHasher.WYHASH)
+        reference.load_dictionary(dict_path, term_index=0, count_index=1, separator=" ")
+        distinct_deletes["count"] = reference.entry_count()
+    sym_spell = SymSpellCpp(max_dictionary_edit_distance=2, prefix_length=7, compact_level=compact_level,
+                            delete_hasher=hasher)
+    sym_spell.load_dictionary(dict_path, term_index=0, count_index=1, separator=" ")
+    benchmark.extra_info["buckets"] = sym_spell.entry_count()
+    benchmark.extra_info["collision_rate"] = 1 - sym_spell.entry_count() / distinct_deletes["count"]
+    words = ["abolution", "intermedaite", "extrine", "memebers", "elipnaht", "aotocrasie"]
+
+    def lookup():
+        return [sym_spell.lookup(word, VerbosityCpp.ALL, 2) for word in words]
+    results = benchmark(lookup)
+    assert (results[0][0].term == "abolition")
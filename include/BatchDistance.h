@@ -0,0 +1,213 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include "BitParallel.h"
+#include "EditDistance.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#    define SYMSPELL_BATCH_X86
+#    include <immintrin.h>
+#    if defined(_MSC_VER) && !defined(__clang__)
+#        include <intrin.h>
+#        define SYMSPELL_AVX2_TARGET
+#    else
+#        define SYMSPELL_AVX2_TARGET __attribute__((target("avx2")))
+#    endif
+#endif
+
+// Bounded edit distance of one pattern (at most 64 chars) against many texts, as EditDistance::Compare
+// would give them one at a time. With AVX2 the texts run through the bit-parallel kernel together, one
+// per lane: eight 32-bit lanes for patterns of at most 32 chars, four 64-bit lanes otherwise. Without AVX2
+// at runtime, and for the texts left over, each text runs the scalar kernel.
+class BatchDistance {
+public:
+    enum Kernel {
+        Scalar,
+        Avx2
+    };
+
+    BatchDistance() : kernel(Detect()) {}
+
+    Kernel GetKernel() const { return kernel; }
+
+    // Forces a kernel, e.g. to compare them; a kernel the CPU does not support falls back to Scalar.
+    void SetKernel(Kernel requested) { kernel = (requested == Avx2) ? Detect() : Scalar; }
+
+    // Best kernel of this CPU, detected once.
+    static Kernel Detect() {
+        static const Kernel detected = HasAvx2() ? Avx2 : Scalar;
+        return detected;
+    }
+
+    // distances[i] = distance of pattern and texts[i], or -1 when it is larger than maxDistance.
+    void Compare(DistanceAlgorithm algorithm, const xchar *pattern, int patternLen, const xchar *const *texts,
+                 const int *textLens, size_t count, int maxDistance, int *distances) {
+        if (maxDistance <= 0) {
+            for (size_t i = 0; i < count; i++)
+                distances[i] = (textLens[i] == patternLen &&
+                                xstring::traits_type::compare(texts[i], pattern, patternLen) == 0) ? 0 : -1;
+            return;
+        }
+        masks.Set(pattern, patternLen);
+        bool transpositions = algorithm == DistanceAlgorithm::DamerauOSADistance;
+        size_t i = 0;
+#ifdef SYMSPELL_BATCH_X86
+        if (kernel == Avx2 && patternLen <= 32 && sizeof(xchar) == 1) {
+            for (; i + 8 <= count; i += 8) {
+                if (transpositions)
+                    CompareAvx2Narrow<true>(masks, patternLen, texts + i, textLens + i, maxDistance, distances + i);
+                else
+                    CompareAvx2Narrow<false>(masks, patternLen, texts + i, textLens + i, maxDistance, distances + i);
+            }
+        }
+        if (kernel == Avx2) {
+            for (; i + Lanes <= count; i += Lanes) {
+                if (transpositions)
+                    CompareAvx2<true>(masks, patternLen, texts + i, textLens + i, maxDistance, distances + i);
+                else
+                    CompareAvx2<false>(masks, patternLen, texts + i, textLens + i, maxDistance, distances + i);
+            }
+        }
+#endif
+        for (; i < count; i++) {
+            if (std::abs(textLens[i] - patternLen) > maxDistance) distances[i] = -1;
+            else if (transpositions) distances[i] = BitParallel::OSA(masks, patternLen, texts[i], textLens[i], maxDistance);
+            else distances[i] = BitParallel::Levenshtein(masks, patternLen, texts[i], textLens[i], maxDistance);
+        }
+    }
+
+private:
+    static const int Lanes = 4;
+
+    Kernel kernel;
+    BitParallel::PatternMasks masks;
+
+    static bool HasAvx2() {
+#if defined(SYMSPELL_BATCH_X86) && defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) return false;
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#elif defined(SYMSPELL_BATCH_X86)
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+#else
+        return false;
+#endif
+    }
+
+#ifdef SYMSPELL_BATCH_X86
+    // The kernel of BitParallel run on four texts at once. Lanes stop moving once their text is consumed;
+    // the diagonal cell of each lane is tracked with a variable shift, which yields 0 while the diagonal
+    // is still above the matrix (negative row, i.e. a huge shift count).
+    template<bool Transpositions>
+    SYMSPELL_AVX2_TARGET static void CompareAvx2(const BitParallel::PatternMasks &masks, int patternLen,
+                                                 const xchar *const *texts, const int *textLens, int maxDistance,
+                                                 int *distances) {
+        int maxLen = 0;
+        for (int l = 0; l < Lanes; l++) maxLen = std::max(maxLen, textLens[l]);
+        const __m256i ones = _mm256_set1_epi64x(-1), one = _mm256_set1_epi64x(1);
+        const __m256i limit = _mm256_set1_epi64x(maxDistance);
+        const __m256i lengths = _mm256_set_epi64x(textLens[3], textLens[2], textLens[1], textLens[0]);
+        __m256i row = _mm256_sub_epi64(_mm256_set1_epi64x(patternLen), lengths);
+        __m256i value = _mm256_set_epi64x(std::abs(patternLen - textLens[3]), std::abs(patternLen - textLens[2]),
+                                          std::abs(patternLen - textLens[1]), std::abs(patternLen - textLens[0]));
+        __m256i vp = ones, vn = _mm256_setzero_si256(), d0 = _mm256_setzero_si256(), prevEq = _mm256_setzero_si256();
+        for (int j = 0; j < maxLen; j++) {
+            uint64_t e[Lanes];
+            for (int l = 0; l < Lanes; l++) e[l] = (j < textLens[l]) ? masks.Get(texts[l][j]) : 0;
+            __m256i eq = _mm256_set_epi64x(e[3], e[2], e[1], e[0]);
+            __m256i active = _mm256_cmpgt_epi64(lengths, _mm256_set1_epi64x(j));
+
+            __m256i x = _mm256_or_si256(eq, vn);
+            if (Transpositions)
+                x = _mm256_or_si256(x, _mm256_and_si256(_mm256_slli_epi64(_mm256_andnot_si256(d0, eq), 1), prevEq));
+            __m256i nd0 = _mm256_or_si256(
+                    _mm256_xor_si256(_mm256_add_epi64(_mm256_and_si256(eq, vp), vp), vp), x);
+            __m256i hp = _mm256_or_si256(
+                    _mm256_slli_epi64(_mm256_or_si256(vn, _mm256_xor_si256(_mm256_or_si256(nd0, vp), ones)), 1), one);
+            __m256i hn = _mm256_slli_epi64(_mm256_and_si256(nd0, vp), 1);
+            __m256i nvp = _mm256_or_si256(hn, _mm256_xor_si256(_mm256_or_si256(nd0, hp), ones));
+            __m256i nvn = _mm256_and_si256(hp, nd0);
+
+            __m256i up = _mm256_add_epi64(_mm256_and_si256(_mm256_srlv_epi64(hp, row), one),
+                                          _mm256_and_si256(_mm256_srlv_epi64(nvp, row), one));
+            __m256i down = _mm256_add_epi64(_mm256_and_si256(_mm256_srlv_epi64(hn, row), one),
+                                            _mm256_and_si256(_mm256_srlv_epi64(nvn, row), one));
+            value = _mm256_add_epi64(value, _mm256_and_si256(_mm256_sub_epi64(up, down), active));
+            row = _mm256_add_epi64(row, _mm256_and_si256(one, active));
+            vp = _mm256_blendv_epi8(vp, nvp, active);
+            vn = _mm256_blendv_epi8(vn, nvn, active);
+            d0 = _mm256_blendv_epi8(d0, nd0, active);
+            prevEq = _mm256_blendv_epi8(prevEq, eq, active);
+
+            // done when every lane is either out of range or at the end of its text
+            __m256i pending = _mm256_andnot_si256(_mm256_cmpgt_epi64(value, limit),
+                                                  _mm256_cmpgt_epi64(lengths, _mm256_set1_epi64x(j + 1)));
+            if (_mm256_testz_si256(pending, pending)) break;
+        }
+        alignas(32) int64_t values[Lanes];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(values), value);
+        for (int l = 0; l < Lanes; l++) distances[l] = (values[l] <= maxDistance) ? (int) values[l] : -1;
+    }
+
+    // Same on eight 32-bit lanes; the masks are gathered straight from the char table of the pattern.
+    template<bool Transpositions>
+    SYMSPELL_AVX2_TARGET static void CompareAvx2Narrow(const BitParallel::PatternMasks &masks, int patternLen,
+                                                       const xchar *const *texts, const int *textLens,
+                                                       int maxDistance, int *distances) {
+        int maxLen = 0;
+        for (int l = 0; l < 8; l++) maxLen = std::max(maxLen, textLens[l]);
+        const __m256i ones = _mm256_set1_epi32(-1), one = _mm256_set1_epi32(1);
+        const __m256i limit = _mm256_set1_epi32(maxDistance);
+        const __m256i lengths = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(textLens));
+        __m256i row = _mm256_sub_epi32(_mm256_set1_epi32(patternLen), lengths);
+        __m256i value = _mm256_abs_epi32(row);
+        __m256i vp = ones, vn = _mm256_setzero_si256(), d0 = _mm256_setzero_si256(), prevEq = _mm256_setzero_si256();
+        const int *table = reinterpret_cast<const int *>(masks.Table());
+        alignas(32) int chars[8];
+        for (int j = 0; j < maxLen; j++) {
+            for (int l = 0; l < 8; l++) chars[l] = (j < textLens[l]) ? (unsigned char) texts[l][j] : 0;
+            // low 32 bits of the 64-bit masks (little endian), patterns are at most 32 chars here
+            __m256i eq = _mm256_i32gather_epi32(table, _mm256_slli_epi32(_mm256_load_si256(
+                    reinterpret_cast<const __m256i *>(chars)), 1), 4);
+            __m256i active = _mm256_cmpgt_epi32(lengths, _mm256_set1_epi32(j));
+
+            __m256i x = _mm256_or_si256(eq, vn);
+            if (Transpositions)
+                x = _mm256_or_si256(x, _mm256_and_si256(_mm256_slli_epi32(_mm256_andnot_si256(d0, eq), 1), prevEq));
+            __m256i nd0 = _mm256_or_si256(
+                    _mm256_xor_si256(_mm256_add_epi32(_mm256_and_si256(eq, vp), vp), vp), x);
+            __m256i hp = _mm256_or_si256(
+                    _mm256_slli_epi32(_mm256_or_si256(vn, _mm256_xor_si256(_mm256_or_si256(nd0, vp), ones)), 1), one);
+            __m256i hn = _mm256_slli_epi32(_mm256_and_si256(nd0, vp), 1);
+            __m256i nvp = _mm256_or_si256(hn, _mm256_xor_si256(_mm256_or_si256(nd0, hp), ones));
+            __m256i nvn = _mm256_and_si256(hp, nd0);
+
+            __m256i up = _mm256_add_epi32(_mm256_and_si256(_mm256_srlv_epi32(hp, row), one),
+                                          _mm256_and_si256(_mm256_srlv_epi32(nvp, row), one));
+            __m256i down = _mm256_add_epi32(_mm256_and_si256(_mm256_srlv_epi32(hn, row), one),
+                                            _mm256_and_si256(_mm256_srlv_epi32(nvn, row), one));
+            value = _mm256_add_epi32(value, _mm256_and_si256(_mm256_sub_epi32(up, down), active));
+            row = _mm256_add_epi32(row, _mm256_and_si256(one, active));
+            vp = _mm256_blendv_epi8(vp, nvp, active);
+            vn = _mm256_blendv_epi8(vn, nvn, active);
+            d0 = _mm256_blendv_epi8(d0, nd0, active);
+            prevEq = _mm256_blendv_epi8(prevEq, eq, active);
+
+            __m256i pending = _mm256_andnot_si256(_mm256_cmpgt_epi32(value, limit),
+                                                  _mm256_cmpgt_epi32(lengths, _mm256_set1_epi32(j + 1)));
+            if (_mm256_testz_si256(pending, pending)) break;
+        }
+        alignas(32) int values[8];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(values), value);
+        for (int l = 0; l < 8; l++) distances[l] = (values[l] <= maxDistance) ? values[l] : -1;
+    }
+#endif
+};
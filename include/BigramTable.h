@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include "FlatArray.h"
+#include "IndexImage.h"
+
+// Bigram counts keyed by the pair of word ids (from the WordTable) packed into 64 bits. Keys and counts
+// are dense arrays in insertion order, and an open-addressing table of indices maps a pair to its entry,
+// so a lookup hashes two integers instead of a "word1 word2" string, and no bigram string is stored.
+class BigramTable {
+private:
+    FlatArray<uint64_t> keys;  // first word id << 32 | second word id
+    FlatArray<int64_t> counts;
+    FlatArray<uint32_t> slots; // index + 1 of the pair hashed to this slot, 0 when empty
+    uint32_t slotMask = 0;
+
+    static uint64_t Key(uint32_t first, uint32_t second) { return (uint64_t) first << 32 | second; }
+
+    static uint32_t Hash(uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdull;
+        key ^= key >> 33;
+        return (uint32_t) key;
+    }
+
+    void Rehash(size_t capacity) {
+        slots.assign(capacity, 0);
+        slotMask = capacity - 1;
+        for (uint32_t index = 0; index < keys.size(); index++) {
+            uint32_t i = Hash(keys[index]) & slotMask;
+            while (slots[i] != 0) i = (i + 1) & slotMask;
+            slots[i] = index + 1;
+        }
+    }
+
+    uint32_t Find(uint64_t key) const {
+        if (slots.empty()) return UINT32_MAX;
+        uint32_t i = Hash(key) & slotMask;
+        while (slots[i] != 0) {
+            uint32_t index = slots[i] - 1;
+            if (keys[index] == key) return index;
+            i = (i + 1) & slotMask;
+        }
+        return UINT32_MAX;
+    }
+
+public:
+    void Reserve(size_t bigrams) {
+        size_t capacity = 16;
+        while (capacity * 3 < bigrams * 4) capacity <<= 1;
+        if (capacity > slots.size()) Rehash(capacity);
+        keys.reserve(bigrams);
+        counts.reserve(bigrams);
+    }
+
+    // Adds the bigram; false (and the count is left alone) when it is already known.
+    bool Add(uint32_t first, uint32_t second, int64_t count) {
+        uint64_t key = Key(first, second);
+        if (Find(key) != UINT32_MAX) return false;
+        if ((keys.size() + 1) * 4 > slots.size() * 3) Rehash(slots.empty() ? 16 : slots.size() * 2);
+        uint32_t i = Hash(key) & slotMask;
+        while (slots[i] != 0) i = (i + 1) & slotMask;
+        slots[i] = keys.size() + 1;
+        keys.push_back(key);
+        counts.push_back(count);
+        return true;
+    }
+
+    // true and the count when the bigram is known
+    bool Find(uint32_t first, uint32_t second, int64_t &count) const {
+        uint32_t index = Find(Key(first, second));
+        if (index == UINT32_MAX) return false;
+        count = counts[index];
+        return true;
+    }
+
+    uint32_t Size() const { return keys.size(); }
+
+    void Save(IndexImage::Writer &image) const {
+        image.Array(keys);
+        image.Array(counts);
+        image.Array(slots);
+        image.Scalar(slotMask);
+    }
+
+    void Map(IndexImage::Reader &image) {
+        image.Array(keys);
+        image.Array(counts);
+        image.Array(slots);
+        slotMask = image.Scalar();
+        // probing wraps around with slotMask, so it must cover exactly the slots, a power of two of them
+        if (counts.size() != keys.size() ||
+            (!slots.empty() && (slots.size() != (size_t) slotMask + 1 || (slotMask & (slotMask + 1)) != 0)))
+            throw std::invalid_argument("Index image has an inconsistent bigram table.");
+        size_t used = 0;
+        for (size_t i = 0; i < slots.size(); i++) {
+            if (slots[i] == 0) continue;
+            if (slots[i] > keys.size())
+                throw std::invalid_argument("Index image has a bigram table slot out of range.");
+            used++;
+        }
+        if (!slots.empty() && used == slots.size())
+            throw std::invalid_argument("Index image has an inconsistent bigram table.");
+    }
+
+    template<class Archive>
+    void serialize(Archive &ar) {
+        ar(keys, counts, slots, slotMask);
+    }
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "Defines.h"
+
+// Bit-parallel edit distance for patterns of at most 64 chars (Myers 1999, in Hyyrö's 2003 formulation).
+// A whole DP column is kept as vertical +1/-1 deltas in two machine words, so every text char costs a
+// handful of word operations instead of a row of cells. The optimal string alignment variant adds
+// Hyyrö's transposition term, which gives the same distances as DamerauOSA's DP.
+class BitParallel {
+public:
+    static const int MaxPatternLength = 64;
+
+    // Positions of every char in the pattern. Only the entries of the current pattern are set, so
+    // switching patterns costs the pattern length rather than the whole table, and setting the same
+    // pattern again (one input verified against many suggestions) costs nothing.
+    class PatternMasks {
+    private:
+        typedef std::make_unsigned<xchar>::type uchar;
+
+        uint64_t direct[256] = {};
+        std::vector<std::pair<xchar, uint64_t>> wide; // chars beyond the direct table
+        xchar pattern[MaxPatternLength] = {}; // copy of the pattern, to clear its entries later
+        int length = 0;
+
+        // true when c has an entry in the direct table; always for 8-bit chars, so there is no comparison
+        // against 256 when it could never fail
+        static bool IsDirect(uchar, std::true_type) { return true; }
+
+        template<class C>
+        static bool IsDirect(C c, std::false_type) { return c < 256; }
+
+        static bool IsDirect(uchar c) { return IsDirect(c, std::integral_constant<bool, sizeof(xchar) == 1>()); }
+
+    public:
+        void Set(const xchar *s, int len) {
+            if (len == length && std::equal(s, s + len, pattern)) return; // same pattern as the last call
+            Clear();
+            std::copy(s, s + len, pattern);
+            length = len;
+            for (int i = 0; i < len; i++) {
+                uchar c = (uchar) s[i];
+                if (IsDirect(c)) {
+                    direct[c] |= uint64_t(1) << i;
+                    continue;
+                }
+                auto it = wide.begin();
+                while (it != wide.end() && it->first != s[i]) ++it;
+                if (it == wide.end()) wide.emplace_back(s[i], uint64_t(1) << i);
+                else it->second |= uint64_t(1) << i;
+            }
+        }
+
+        void Clear() {
+            for (int i = 0; i < length; i++) {
+                uchar c = (uchar) pattern[i];
+                if (IsDirect(c)) direct[c] = 0;
+            }
+            wide.clear();
+            length = 0;
+        }
+
+        // masks of the chars below 256, indexed by char
+        const uint64_t *Table() const { return direct; }
+
+        uint64_t Get(xchar c) const {
+            if (IsDirect((uchar) c)) return direct[(uchar) c];
+            for (const auto &entry : wide)
+                if (entry.first == c) return entry.second;
+            return 0;
+        }
+    };
+
+    // Levenshtein distance between the pattern of masks (1..64 chars long) and text, or -1 when it is
+    // larger than maxDistance.
+    static int Levenshtein(const PatternMasks &masks, int patternLen, const xchar *text, int textLen,
+                           int maxDistance) {
+        return Run<false>(masks, patternLen, text, textLen, maxDistance);
+    }
+
+    // Optimal string alignment distance, as Levenshtein but adjacent transpositions cost 1.
+    static int OSA(const PatternMasks &masks, int patternLen, const xchar *text, int textLen, int maxDistance) {
+        return Run<true>(masks, patternLen, text, textLen, maxDistance);
+    }
+
+private:
+    // vp/vn hold the +1/-1 vertical deltas of the current column, hp/hn the horizontal ones of the last step.
+    // Instead of the bottom row, the cell on the diagonal that ends in the bottom right corner is tracked:
+    // values never decrease along a diagonal, so the loop stops as soon as that cell exceeds maxDistance.
+    template<bool Transpositions>
+    static int Run(const PatternMasks &masks, int patternLen, const xchar *text, int textLen, int maxDistance) {
+        uint64_t vp = ~uint64_t(0), vn = 0, d0 = 0, prevEq = 0;
+        int row = patternLen - textLen; // row of the tracked cell in the current column
+        int value = row;                // its distance, once the diagonal has entered the matrix
+        if (value > maxDistance) return -1;
+        for (int j = 0; j < textLen; j++) {
+            uint64_t eq = masks.Get(text[j]);
+            uint64_t x = eq | vn;
+            if (Transpositions) {
+                x |= ((~d0 & eq) << 1) & prevEq;
+                prevEq = eq;
+            }
+            d0 = (((eq & vp) + vp) ^ vp) | x;
+            uint64_t hp = ((vn | ~(d0 | vp)) << 1) | 1;
+            uint64_t hn = (d0 & vp) << 1;
+            vp = hn | ~(d0 | hp);
+            vn = hp & d0;
+            if (row >= 0) {
+                // step down the diagonal: right along row `row`, then down in the new column
+                value += (int) ((hp >> row) & 1) - (int) ((hn >> row) & 1) + (int) ((vp >> row) & 1) -
+                         (int) ((vn >> row) & 1);
+                if (value > maxDistance) return -1;
+            } else if (row == -1) {
+                value = j + 1; // first row is the number of text chars
+                if (value > maxDistance) return -1;
+            }
+            row++;
+        }
+        return value;
+    }
+};
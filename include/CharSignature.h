@@ -0,0 +1,36 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include "Defines.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// 64-bit set of the characters of a word, every character mapped to one bit by its code modulo 64.
+// An insertion, deletion or substitution adds at most one character to a word and takes at most one
+// away (a transposition neither), so the edit distance of two words is at least the number of bits
+// that only one of their signatures has, counted on the side that has more of them. Characters that
+// share a bit only make the bound weaker, never wrong.
+class CharSignature {
+public:
+    static uint64_t Of(const xchar *s, size_t len) {
+        uint64_t signature = 0;
+        for (size_t i = 0; i < len; i++) signature |= 1ull << ((uint32_t) s[i] & 63);
+        return signature;
+    }
+
+    static int LowerBound(uint64_t a, uint64_t b) {
+        return std::max(PopCount(a & ~b), PopCount(b & ~a));
+    }
+
+private:
+    static int PopCount(uint64_t bits) {
+#ifdef _MSC_VER
+        return (int) __popcnt64(bits);
+#else
+        return __builtin_popcountll(bits);
+#endif
+    }
+};
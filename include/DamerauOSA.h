@@ -7,6 +7,7 @@
 #include "BaseDistance.h"
 #include "BaseSimilarity.h"
 #include "Helpers.h"
+#include "BitParallel.h"
 #include <vector>
 #include <cmath>
 #include <climits>
@@ -16,6 +17,7 @@ class DamerauOSA : public BaseDistance, BaseSimilarity {
 private:
     std::vector<int> baseChar1Costs;
     std::vector<int> basePrevChar1Costs;
+    BitParallel::PatternMasks patternMasks;
 
 public:
     DamerauOSA() = default;
@@ -29,6 +31,11 @@ public:
     double Distance(const xstring& string1, const xstring& string2) override {
         if (string1.empty()) return string2.size();
         if (string2.empty()) return string1.size();
+        if (string1.size() <= BitParallel::MaxPatternLength) {
+            patternMasks.Set(string1.data(), string1.size());
+            return BitParallel::OSA(patternMasks, string1.size(), string2.data(), string2.size(),
+                                    std::max(string1.size(), string2.size()));
+        }
 
         const xstring& str1 = (string1.size() > string2.size()) ? string2 : string1;
         const xstring& str2 = (string1.size() > string2.size()) ? string1 : string2;
@@ -54,6 +61,11 @@ public:
         const xstring& str2 = (string1.size() > string2.size()) ? string1 : string2;
 
         if (str2.size() - str1.size() > iMaxDistance) return -1;
+        if (string1.size() <= BitParallel::MaxPatternLength) {
+            // string1 is the pattern, so verifying one input against many strings builds its masks once
+            patternMasks.Set(string1.data(), string1.size());
+            return BitParallel::OSA(patternMasks, string1.size(), string2.data(), string2.size(), iMaxDistance);
+        }
 
         int len1, len2, start;
         Helpers::PrefixSuffixPrep(str1, str2, len1, len2, start);
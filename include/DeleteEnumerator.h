@@ -0,0 +1,117 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "Defines.h"
+
+// Enumerates the distinct deletes of a dictionary word without allocating per delete. Deletes are
+// built in place, one buffer per edit distance level, and the ones already produced for the current
+// word are remembered in an open-addressing table over a character arena; both are reused across words.
+class DeleteEnumerator {
+private:
+    struct Seen {
+        uint32_t stamp; // entry belongs to the current word when equal to stamp
+        uint32_t hash;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    static const int StackLevelChars = 256;
+
+    std::vector<Seen> table;
+    uint32_t tableMask = 0;
+    uint32_t stamp = 0;
+    std::vector<xchar> arena;
+    std::vector<xchar> heapLevels;
+
+    void Begin(int prefixLen, int levels) {
+        // upper bound of the distinct deletes: the empty string, the prefix and C(prefixLen, k) per level
+        double bound = 2, choose = 1;
+        for (int k = 1; k <= levels && k <= prefixLen; k++) {
+            choose = choose * (prefixLen - k + 1) / k;
+            bound += choose;
+        }
+        size_t capacity = 16;
+        while (capacity < bound * 2 && capacity < (1u << 30)) capacity <<= 1;
+        if (capacity > table.size()) {
+            table.assign(capacity, Seen{0, 0, 0, 0});
+            tableMask = capacity - 1;
+        }
+        if (++stamp == 0) {
+            std::fill(table.begin(), table.end(), Seen{0, 0, 0, 0});
+            stamp = 1;
+        }
+        arena.clear();
+    }
+
+    // true when s was not produced before for the current word
+    bool Insert(const xchar *s, int len, uint32_t hash) {
+        uint32_t i = hash & tableMask;
+        while (table[i].stamp == stamp) {
+            const Seen &seen = table[i];
+            if (seen.hash == hash && seen.length == (uint32_t) len &&
+                xstring::traits_type::compare(arena.data() + seen.offset, s, len) == 0)
+                return false;
+            i = (i + 1) & tableMask;
+        }
+        table[i] = Seen{stamp, hash, (uint32_t) arena.size(), (uint32_t) len};
+        arena.insert(arena.end(), s, s + len);
+        return true;
+    }
+
+    template<class Fn>
+    void Recurse(const xchar *word, int len, int distance, int maxDistance, xchar *levels, int levelSize, Fn &fn) {
+        distance++;
+        if (len <= 1) return;
+        xchar *del = levels + (distance - 1) * levelSize;
+        // del starts as word without its first char; moving the gap one step right only changes del[i]
+        std::copy(word + 1, word + len, del);
+        for (int i = 0; i < len; i++) {
+            if (i > 0) del[i - 1] = word[i - 1];
+            uint32_t hash = Fnv(del, len - 1);
+            if (Insert(del, len - 1, hash)) {
+                fn(del, len - 1, hash);
+                if (distance < maxDistance) Recurse(del, len - 1, distance, maxDistance, levels, levelSize, fn);
+            }
+        }
+    }
+
+public:
+    static const uint32_t FnvOffset = 2166136261u;
+
+    static uint32_t FnvStep(uint32_t hash, xchar c) {
+        hash ^= c;
+        return hash * 16777619;
+    }
+
+    // 32-bit FNV-1a over the characters, the unmasked part of SymSpell's delete hash
+    static uint32_t Fnv(const xchar *s, int len) {
+        uint32_t hash = FnvOffset;
+        for (int i = 0; i < len; i++) hash = FnvStep(hash, s[i]);
+        return hash;
+    }
+
+    // Calls fn(chars, length, fnv) once for every distinct delete of key: the empty string when key is at
+    // most maxDistance long, the first prefixLength chars of key, and everything reached from that prefix
+    // by removing characters (one level even when maxDistance is 0, as SymSpell always did). The chars
+    // passed to fn are only valid during the call.
+    template<class Fn>
+    void ForEach(const xchar *key, int keyLen, int prefixLength, int maxDistance, Fn fn) {
+        int len = std::min(keyLen, prefixLength);
+        int levels = std::max(1, maxDistance);
+        Begin(len, levels);
+
+        if (keyLen <= maxDistance && Insert(key, 0, FnvOffset)) fn(key, 0, FnvOffset);
+        uint32_t hash = Fnv(key, len);
+        if (Insert(key, len, hash)) fn(key, len, hash);
+
+        xchar stackLevels[StackLevelChars];
+        xchar *buffer = stackLevels;
+        if (levels * len > StackLevelChars) {
+            if (heapLevels.size() < (size_t) (levels * len)) heapLevels.resize(levels * len);
+            buffer = heapLevels.data();
+        }
+        Recurse(key, len, 0, maxDistance, buffer, len, fn);
+    }
+};
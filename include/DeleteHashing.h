@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include "Defines.h"
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+// Hash functions that turn a delete into the 64-bit key of its bucket.
+enum DeleteHasher {
+    Fnv32,  // 32-bit FNV-1a masked by compactLevel, with the length in the low bits (the original SymSpell key)
+    Fnv64,  // 64-bit FNV-1a, unmasked
+    WyHash  // wyhash (final version 4) of the characters' bytes, unmasked
+};
+
+class DeleteHashing {
+public:
+    static uint64_t Fnv64(const xchar *s, int len) {
+        uint64_t hash = 14695981039346656037ull;
+        for (int i = 0; i < len; i++) {
+            hash ^= (uint64_t) (typename std::make_unsigned<xchar>::type) s[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // wyhash with its default secret and seed 0, over the bytes of the characters
+    static uint64_t WyHash(const xchar *s, int len) {
+        static const uint64_t secret[4] = {0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull,
+                                           0x4d5a2da51de1aa47ull};
+        const uint8_t *p = (const uint8_t *) s;
+        size_t size = (size_t) len * sizeof(xchar);
+        uint64_t seed = Mix(secret[0], secret[1]);
+        uint64_t a, b;
+        if (size <= 16) {
+            if (size >= 4) {
+                a = (Read4(p) << 32) | Read4(p + ((size >> 3) << 2));
+                b = (Read4(p + size - 4) << 32) | Read4(p + size - 4 - ((size >> 3) << 2));
+            } else if (size > 0) {
+                a = ((uint64_t) p[0] << 16) | ((uint64_t) p[size >> 1] << 8) | p[size - 1];
+                b = 0;
+            } else {
+                a = b = 0;
+            }
+        } else {
+            size_t i = size;
+            if (i > 48) {
+                uint64_t see1 = seed, see2 = seed;
+                do {
+                    seed = Mix(Read8(p) ^ secret[1], Read8(p + 8) ^ seed);
+                    see1 = Mix(Read8(p + 16) ^ secret[2], Read8(p + 24) ^ see1);
+                    see2 = Mix(Read8(p + 32) ^ secret[3], Read8(p + 40) ^ see2);
+                    p += 48;
+                    i -= 48;
+                } while (i > 48);
+                seed ^= see1 ^ see2;
+            }
+            while (i > 16) {
+                seed = Mix(Read8(p) ^ secret[1], Read8(p + 8) ^ seed);
+                i -= 16;
+                p += 16;
+            }
+            a = Read8(p + i - 16);
+            b = Read8(p + i - 8);
+        }
+        a ^= secret[1];
+        b ^= seed;
+        Multiply(a, b);
+        return Mix(a ^ secret[0] ^ size, b ^ secret[1]);
+    }
+
+private:
+    // a, b = low and high half of the 128-bit product a * b
+    static void Multiply(uint64_t &a, uint64_t &b) {
+#if defined(__SIZEOF_INT128__)
+        unsigned __int128 product = (unsigned __int128) a * b;
+        a = (uint64_t) product;
+        b = (uint64_t) (product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+        a = _umul128(a, b, &b);
+#else
+        uint64_t ha = a >> 32, hb = b >> 32, la = (uint32_t) a, lb = (uint32_t) b;
+        uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32);
+        uint64_t carry = t < rl;
+        uint64_t lo = t + (rm1 << 32);
+        carry += lo < t;
+        uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+        a = lo;
+        b = hi;
+#endif
+    }
+
+    static uint64_t Mix(uint64_t a, uint64_t b) {
+        Multiply(a, b);
+        return a ^ b;
+    }
+
+    static uint64_t Read8(const uint8_t *p) {
+        uint64_t value;
+        std::memcpy(&value, p, 8);
+        return value;
+    }
+
+    static uint64_t Read4(const uint8_t *p) {
+        uint32_t value;
+        std::memcpy(&value, p, 4);
+        return value;
+    }
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "Defines.h"
+
+// Splitting of delimited dictionary text without copies: lines and fields are ranges of the text itself,
+// found with traits::find (memchr for narrow chars). Fields split like getline does, so "a  b" has an empty
+// middle field and a separator at the end of a line adds no empty field.
+namespace DelimitedText {
+    typedef xstring::traits_type Traits;
+
+    struct Field {
+        const xchar *data;
+        size_t size;
+    };
+
+    // Calls f(line, length, lineNumber) for every line; '\n' (or "\r\n") ends a line and is not part of it,
+    // the last line needs none.
+    template<class F>
+    void ForEachLine(const xchar *text, size_t size, F f) {
+        const xchar *end = text + size;
+        size_t lineNumber = 0;
+        while (text < end) {
+            const xchar *newline = Traits::find(text, end - text, XL('\n'));
+            if (newline == nullptr) newline = end;
+            size_t length = newline - text;
+            if (length > 0 && text[length - 1] == XL('\r')) length--;
+            f(text, length, ++lineNumber);
+            text = newline + 1;
+        }
+    }
+
+    // Replaces fields with the fields of the line; the vector is reused so no line allocates.
+    inline void Split(const xchar *line, size_t length, xchar separator, std::vector<Field> &fields) {
+        fields.clear();
+        const xchar *end = line + length;
+        while (line < end) {
+            const xchar *next = Traits::find(line, end - line, separator);
+            if (next == nullptr) next = end;
+            fields.push_back(Field{line, (size_t) (next - line)});
+            line = next + 1;
+        }
+    }
+
+    // Parses a count as std::stoll does (leading white space, an optional sign, then digits; anything after
+    // the digits is ignored). False when there are no digits or the value does not fit in 64 bits.
+    inline bool ParseCount(const xchar *s, size_t length, int64_t &count) {
+        const xchar *end = s + length;
+        while (s < end && (*s == XL(' ') || (*s >= XL('\t') && *s <= XL('\r')))) s++;
+        bool negative = false;
+        if (s < end && (*s == XL('+') || *s == XL('-'))) negative = *s++ == XL('-');
+        if (s == end || *s < XL('0') || *s > XL('9')) return false;
+        uint64_t limit = (uint64_t) INT64_MAX + (negative ? 1 : 0), value = 0;
+        for (; s < end && *s >= XL('0') && *s <= XL('9'); s++) {
+            uint64_t digit = *s - XL('0');
+            if (value > (limit - digit) / 10) return false;
+            value = value * 10 + digit;
+        }
+        count = negative ? -(int64_t) (value - 1) - 1 : (int64_t) value;
+        return true;
+    }
+}
@@ -18,25 +18,21 @@ enum DistanceAlgorithm {
 
 class EditDistance {
 private:
-    BaseDistance *distanceComparer;
+    DistanceAlgorithm algorithm;
     DamerauOSA damerauOSADistance;
     Levenshtein levenshteinDistance;
 
 public:
-    explicit EditDistance(DistanceAlgorithm algorithm) {
-        switch (algorithm) {
-            case DistanceAlgorithm::DamerauOSADistance:
-                this->distanceComparer = &damerauOSADistance;
-                break;
-            case DistanceAlgorithm::LevenshteinDistance:
-                this->distanceComparer = &levenshteinDistance;
-                break;
-            default:
-                throw std::invalid_argument("Unknown distance algorithm.");
-        }
+    explicit EditDistance(DistanceAlgorithm algorithm) : algorithm(algorithm) {
+        if (algorithm != DistanceAlgorithm::DamerauOSADistance && algorithm != DistanceAlgorithm::LevenshteinDistance)
+            throw std::invalid_argument("Unknown distance algorithm.");
     }
 
-    int Compare(xstring string1, xstring string2, double maxDistance) {
-        return (int) this->distanceComparer->Distance(std::move(string1), std::move(string2), maxDistance);
+    DistanceAlgorithm Algorithm() const { return algorithm; }
+
+    int Compare(const xstring &string1, const xstring &string2, double maxDistance) {
+        if (algorithm == DistanceAlgorithm::LevenshteinDistance)
+            return (int) levenshteinDistance.Distance(string1, string2, maxDistance);
+        return (int) damerauOSADistance.Distance(string1, string2, maxDistance);
     }
 };
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <type_traits>
+#include "cereal/cereal.hpp"
+
+// Contiguous array of trivially copyable values that either owns its storage or views a read-only
+// region (e.g. a memory mapped index image). Reads go straight to the data pointer; the first
+// mutation of a viewed array copies it into owned storage.
+template<class T>
+class FlatArray {
+    static_assert(std::is_trivially_copyable<T>::value, "FlatArray only holds trivially copyable values");
+
+private:
+    std::vector<T> values;
+    const T *ptr = nullptr;
+    size_t count = 0;
+    bool viewed = false;
+
+    void Sync() {
+        ptr = values.data();
+        count = values.size();
+    }
+
+    void Own() {
+        if (viewed) {
+            values.assign(ptr, ptr + count);
+            viewed = false;
+            Sync();
+        }
+    }
+
+public:
+    FlatArray() = default;
+
+    FlatArray(std::initializer_list<T> init) : values(init) { Sync(); }
+
+    FlatArray(const FlatArray &other) : values(other.ptr, other.ptr + other.count) { Sync(); }
+
+    FlatArray &operator=(const FlatArray &other) {
+        if (this != &other) {
+            values.assign(other.ptr, other.ptr + other.count);
+            viewed = false;
+            Sync();
+        }
+        return *this;
+    }
+
+    FlatArray(FlatArray &&other) noexcept { *this = std::move(other); }
+
+    FlatArray &operator=(FlatArray &&other) noexcept {
+        if (this != &other) {
+            values = std::move(other.values);
+            ptr = other.ptr;
+            count = other.count;
+            viewed = other.viewed;
+            other.values.clear();
+            other.viewed = false;
+            other.Sync();
+        }
+        return *this;
+    }
+
+    // Points the array at external memory, which must outlive it (or its next mutation).
+    void View(const T *data, size_t size) {
+        values.clear();
+        values.shrink_to_fit();
+        ptr = data;
+        count = size;
+        viewed = true;
+    }
+
+    bool IsView() const { return viewed; }
+
+    size_t size() const { return count; }
+
+    bool empty() const { return count == 0; }
+
+    const T *data() const { return ptr; }
+
+    const T *begin() const { return ptr; }
+
+    const T *end() const { return ptr + count; }
+
+    const T &back() const { return ptr[count - 1]; }
+
+    const T &operator[](size_t i) const { return ptr[i]; }
+
+    T &operator[](size_t i) {
+        Own();
+        return values[i];
+    }
+
+    T *MutableData() {
+        Own();
+        return values.data();
+    }
+
+    void reserve(size_t n) {
+        Own();
+        values.reserve(n);
+        Sync();
+    }
+
+    void resize(size_t n) {
+        Own();
+        values.resize(n);
+        Sync();
+    }
+
+    void assign(size_t n, const T &value) {
+        viewed = false;
+        values.assign(n, value);
+        Sync();
+    }
+
+    template<class It>
+    void assign(It first, It last) {
+        std::vector<T> copy(first, last); // first/last may point into this array
+        viewed = false;
+        values.swap(copy);
+        Sync();
+    }
+
+    void push_back(const T &value) {
+        Own();
+        values.push_back(value);
+        Sync();
+    }
+
+    template<class It>
+    void append(It first, It last) {
+        Own();
+        values.insert(values.end(), first, last);
+        Sync();
+    }
+
+    void clear() {
+        viewed = false;
+        values.clear();
+        Sync();
+    }
+
+    // same encoding as cereal's std::vector of arithmetic values in binary archives
+    template<class Archive>
+    void save(Archive &ar) const {
+        ar(cereal::make_size_tag(static_cast<cereal::size_type>(count)));
+        ar(cereal::binary_data(ptr, count * sizeof(T)));
+    }
+
+    template<class Archive>
+    void load(Archive &ar) {
+        cereal::size_type size;
+        ar(cereal::make_size_tag(size));
+        viewed = false;
+        values.resize(static_cast<size_t>(size));
+        ar(cereal::binary_data(values.data(), static_cast<size_t>(size) * sizeof(T)));
+        Sync();
+    }
+};
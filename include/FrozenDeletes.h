@@ -0,0 +1,292 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include "Helpers.h"
+#include "FlatArray.h"
+#include "IndexImage.h"
+#include "Parallel.h"
+
+// Read-optimized delete index in compressed sparse row layout: an open-addressing table maps each
+// delete hash to a bucket, and every bucket is a contiguous span of 32-bit word ids inside one
+// shared array. Built in one pass from the previous index, the mutable overlay and a staging area.
+// Every slot also holds the length range of its bucket's words, so a lookup can reject a bucket without
+// reading its ids. Within a bucket the ids are ordered by word length, and a parallel array holds the
+// length byte of every id, so the ids of a range of lengths are found by a binary search of the bytes.
+class FrozenDeletes {
+public:
+    struct Slot {
+        uint64_t hash;
+        uint32_t bucket;
+        LengthRange range;
+    };
+
+    static const uint32_t EmptySlot = UINT32_MAX;
+
+private:
+    FlatArray<Slot> slots;
+    FlatArray<uint64_t> hashes;  // delete key of every bucket
+    FlatArray<uint32_t> offsets; // bucket b spans ids[offsets[b], offsets[b + 1])
+    FlatArray<uint32_t> ids;
+    FlatArray<uint8_t> lengths;  // LengthByte of the word of ids[i]
+    uint32_t slotMask = 0;
+    int slotShift = 32;
+
+    uint32_t SlotOf(uint64_t hash) const {
+        return (uint32_t) ((hash * 0x9e3779b97f4a7c15ull) >> (32 + slotShift));
+    }
+
+    void InitSlots(size_t expectedBuckets) {
+        size_t capacity = 16;
+        int bits = 4;
+        while (capacity < expectedBuckets * 2) {
+            capacity <<= 1;
+            bits++;
+        }
+        slots.assign(capacity, Slot{0, EmptySlot, LengthRange()});
+        slotMask = capacity - 1;
+        slotShift = 32 - bits;
+    }
+
+    uint32_t FindSlot(uint64_t hash) const {
+        uint32_t i = SlotOf(hash);
+        while (slots[i].bucket != EmptySlot && slots[i].hash != hash)
+            i = (i + 1) & slotMask;
+        return i;
+    }
+
+    // Orders the ids of every bucket by length, keeping the order of ids of the same length, and sets the
+    // length bytes and length ranges from lengthOf(id).
+    template<class LengthOf>
+    void SortBuckets(LengthOf lengthOf, int threads) {
+        lengths.resize(ids.size());
+        uint32_t *idData = ids.MutableData();
+        uint8_t *lengthData = lengths.MutableData();
+        Slot *slotData = slots.MutableData();
+        const size_t chunk = 4096;
+        Parallel::For((hashes.size() + chunk - 1) / chunk, threads, [&](size_t c) {
+            std::vector<std::pair<uint8_t, uint32_t>> entries;
+            for (uint32_t b = c * chunk; b < hashes.size() && b < (c + 1) * chunk; ++b) {
+                LengthRange &range = slotData[FindSlot(hashes[b])].range;
+                range = LengthRange();
+                entries.clear();
+                for (uint32_t i = offsets[b]; i < offsets[b + 1]; ++i) {
+                    int length = lengthOf(idData[i]);
+                    range.Add(length);
+                    entries.emplace_back(LengthByte(length), idData[i]);
+                }
+                std::stable_sort(entries.begin(), entries.end(),
+                                 [](const std::pair<uint8_t, uint32_t> &a, const std::pair<uint8_t, uint32_t> &b) {
+                                     return a.first < b.first;
+                                 });
+                for (size_t i = 0; i < entries.size(); i++) {
+                    lengthData[offsets[b] + i] = entries[i].first;
+                    idData[offsets[b] + i] = entries[i].second;
+                }
+            }
+        });
+    }
+
+    void Count(uint64_t hash, uint32_t n, std::vector<uint32_t> &counts) {
+        Slot &slot = slots[FindSlot(hash)];
+        if (slot.bucket == EmptySlot) {
+            slot.hash = hash;
+            slot.bucket = hashes.size();
+            hashes.push_back(hash);
+            counts.push_back(0);
+        }
+        counts[slot.bucket] += n;
+    }
+
+public:
+    FrozenDeletes() = default;
+
+    uint32_t BucketCount() const { return hashes.size(); }
+
+    size_t IdCount() const { return ids.size(); }
+
+    bool Find(uint64_t hash, const uint32_t *&begin, const uint32_t *&end) const {
+        if (slots.empty()) return false;
+        const Slot &slot = slots[FindSlot(hash)];
+        if (slot.bucket == EmptySlot) return false;
+        begin = ids.data() + offsets[slot.bucket];
+        end = ids.data() + offsets[slot.bucket + 1];
+        return true;
+    }
+
+    // The ids, length bytes and length range of the bucket of hash.
+    bool Find(uint64_t hash, const uint32_t *&begin, const uint8_t *&lengthBytes, uint32_t &count,
+              LengthRange &range) const {
+        if (slots.empty()) return false;
+        const Slot &slot = slots[FindSlot(hash)];
+        if (slot.bucket == EmptySlot) return false;
+        begin = ids.data() + offsets[slot.bucket];
+        lengthBytes = lengths.data() + offsets[slot.bucket];
+        count = offsets[slot.bucket + 1] - offsets[slot.bucket];
+        range = slot.range;
+        return true;
+    }
+
+    bool Contains(uint64_t hash) const {
+        const uint32_t *begin, *end;
+        return Find(hash, begin, end);
+    }
+
+    // Rebuilds this index as previous + overlay + the staging areas, in that order. Within a bucket the
+    // entries are ordered by length, and entries of the same length keep the order they would have in the
+    // mutable std::unordered_map index: older entries first, then the staged ones. With several threads the
+    // staged ids are copied and the buckets sorted in parallel, every bucket being filled by a single worker.
+    // lengthOf(id) gives the length of a word.
+    template<class LengthOf>
+    void Merge(const FrozenDeletes *previous, const std::unordered_map<uint64_t, DeleteBucket> *overlay,
+               const std::vector<SuggestionStage *> &stages, LengthOf lengthOf, int threads = 1) {
+        size_t expectedBuckets = 0;
+        for (SuggestionStage *stage : stages) expectedBuckets += stage->DeleteCount();
+        if (previous != nullptr) expectedBuckets += previous->BucketCount();
+        if (overlay != nullptr) expectedBuckets += overlay->size();
+
+        hashes.clear();
+        hashes.reserve(expectedBuckets);
+        InitSlots(expectedBuckets);
+        std::vector<uint32_t> counts;
+        counts.reserve(expectedBuckets);
+
+        if (previous != nullptr) {
+            for (uint32_t b = 0; b < previous->BucketCount(); ++b)
+                Count(previous->hashes[b], previous->offsets[b + 1] - previous->offsets[b], counts);
+        }
+        if (overlay != nullptr) {
+            for (auto &bucket : *overlay)
+                Count(bucket.first, bucket.second.ids.size(), counts);
+        }
+        for (SuggestionStage *stage : stages)
+            stage->ForEachBucket([&](uint64_t hash, const Entry &entry) { Count(hash, entry.count, counts); });
+
+        offsets.assign(hashes.size() + 1, 0);
+        for (uint32_t b = 0; b < hashes.size(); ++b)
+            offsets[b + 1] = offsets[b] + counts[b];
+        ids.resize(offsets.back());
+
+        std::vector<uint32_t> &cursor = counts;
+        std::copy(offsets.begin(), offsets.end() - 1, cursor.begin());
+        uint32_t *out = ids.MutableData();
+        if (previous != nullptr) {
+            for (uint32_t b = 0; b < previous->BucketCount(); ++b) {
+                uint32_t target = slots[FindSlot(previous->hashes[b])].bucket;
+                for (uint32_t i = previous->offsets[b]; i < previous->offsets[b + 1]; ++i)
+                    out[cursor[target]++] = previous->ids[i];
+            }
+        }
+        if (overlay != nullptr) {
+            for (auto &bucket : *overlay) {
+                uint32_t target = slots[FindSlot(bucket.first)].bucket;
+                for (uint32_t id : bucket.second.ids)
+                    out[cursor[target]++] = id;
+            }
+        }
+
+        int workers = Parallel::WorkerCount(threads, hashes.size());
+        if (workers <= 1) {
+            for (SuggestionStage *stage : stages) {
+                stage->ForEachBucket([&](uint64_t hash, const Entry &entry) {
+                    uint32_t &position = cursor[slots[FindSlot(hash)].bucket];
+                    stage->ForEachSuggestion(entry, [&](uint32_t id) { out[position++] = id; });
+                });
+            }
+            SortBuckets(lengthOf, 1);
+            return;
+        }
+
+        struct StagedBucket {
+            uint32_t target;
+            SuggestionStage *stage;
+            const Entry *entry;
+        };
+        std::vector<std::vector<StagedBucket>> partitions(workers);
+        for (SuggestionStage *stage : stages) {
+            stage->ForEachBucket([&](uint64_t hash, const Entry &entry) {
+                uint32_t target = slots[FindSlot(hash)].bucket;
+                partitions[target % workers].push_back(StagedBucket{target, stage, &entry});
+            });
+        }
+        Parallel::For(workers, workers, [&](size_t w) {
+            for (const StagedBucket &bucket : partitions[w]) {
+                uint32_t &position = cursor[bucket.target];
+                bucket.stage->ForEachSuggestion(*bucket.entry, [&](uint32_t id) { out[position++] = id; });
+            }
+        });
+        SortBuckets(lengthOf, workers);
+    }
+
+    // Rebuilds this index as source without the ids keep(id) rejects; buckets left empty are dropped.
+    template<class Keep, class LengthOf>
+    void Compact(const FrozenDeletes &source, Keep keep, LengthOf lengthOf) {
+        hashes.clear();
+        offsets.assign(1, 0);
+        ids.clear();
+        for (uint32_t b = 0; b < source.BucketCount(); ++b) {
+            for (uint32_t i = source.offsets[b]; i < source.offsets[b + 1]; ++i)
+                if (keep(source.ids[i])) ids.push_back(source.ids[i]);
+            if (ids.size() == offsets.back()) continue;
+            hashes.push_back(source.hashes[b]);
+            offsets.push_back(ids.size());
+        }
+        InitSlots(hashes.size());
+        for (uint32_t b = 0; b < hashes.size(); ++b) {
+            Slot &slot = slots[FindSlot(hashes[b])];
+            slot.hash = hashes[b];
+            slot.bucket = b;
+        }
+        SortBuckets(lengthOf, 1);
+    }
+
+    void Save(IndexImage::Writer &image) const {
+        image.Array(slots);
+        image.Array(hashes);
+        image.Array(offsets);
+        image.Array(ids);
+        image.Array(lengths);
+        image.Scalar(slotMask);
+        image.Scalar(slotShift);
+    }
+
+    // Views the arrays of an image written by Save; every id must be below wordCount. Anything a lookup would
+    // follow out of bounds (ids, bucket spans, slots) is checked, so a bad image throws here and not later.
+    void Map(IndexImage::Reader &image, uint32_t wordCount) {
+        image.Array(slots);
+        image.Array(hashes);
+        image.Array(offsets);
+        image.Array(ids);
+        image.Array(lengths);
+        slotMask = image.Scalar();
+        slotShift = image.Scalar();
+        if (offsets.size() != hashes.size() + 1 || offsets.back() != ids.size() || lengths.size() != ids.size() ||
+            (!slots.empty() && (slotShift < 0 || slotShift > 32 || slots.size() != (size_t) slotMask + 1 ||
+                                slots.size() != (size_t) 1 << (32 - slotShift))))
+            throw std::invalid_argument("Index image has an inconsistent delete index.");
+        for (size_t b = 0; b < hashes.size(); b++) {
+            if (offsets[b] > offsets[b + 1])
+                throw std::invalid_argument("Index image has an inconsistent delete index.");
+        }
+        for (size_t i = 0; i < ids.size(); i++) {
+            if (ids[i] >= wordCount)
+                throw std::invalid_argument("Index image has a delete index id out of range.");
+        }
+        // every bucket has exactly one slot, and at least one slot is empty so that probing ends
+        size_t used = 0;
+        for (size_t i = 0; i < slots.size(); i++) {
+            if (slots[i].bucket == EmptySlot) continue;
+            if (slots[i].bucket >= hashes.size() || hashes[slots[i].bucket] != slots[i].hash)
+                throw std::invalid_argument("Index image has a delete index slot out of range.");
+            used++;
+        }
+        if (!slots.empty() && (used != hashes.size() || used == slots.size()))
+            throw std::invalid_argument("Index image has an inconsistent delete index.");
+    }
+
+    template<class Archive>
+    void serialize(Archive &ar) {
+        ar(slots, hashes, offsets, ids, lengths, slotMask, slotShift);
+    }
+};
@@ -4,11 +4,13 @@
 
 #pragma once
 
+#include <algorithm>
 #include <unordered_map>
 #include <utility>
 #include <sys/stat.h>
 #include "iostream"
 #include "Defines.h"
+#include "LengthHistogram.h"
 #define DIFFLIB_ENABLE_EXTERN_MACROS
 #include <difflib.h>
 
@@ -236,7 +238,7 @@ public:
 
 class Node {
 public:
-    xstring suggestion;
+    uint32_t suggestion;
     int next;
 };
 
@@ -246,9 +248,69 @@ public:
     int first;
 };
 
+// Word ids of one delete in the mutable index. The ids are kept in order of word length, with the length
+// byte of every id in a parallel array, so the ids of the lengths a lookup wants are found by a binary
+// search of the bytes. New ids are appended to an unsorted tail that is merged into the sorted part once
+// it outgrows an eighth of the bucket, which keeps appends amortized O(1); within a length the ids keep
+// the order they were added in.
+class DeleteBucket {
+public:
+    std::vector<uint32_t> ids;
+    std::vector<uint8_t> lengths; // LengthByte of the word of ids[i]
+    uint32_t sorted = 0;          // ids[0, sorted) are ordered by length
+    LengthRange range;
+
+    void Add(uint32_t id, int length) {
+        ids.push_back(id);
+        lengths.push_back(LengthByte(length));
+        range.Add(length);
+        size_t tail = ids.size() - sorted;
+        if (tail > 8 && tail * 8 > ids.size()) Sort();
+    }
+
+    // Merges the unsorted tail into the sorted part.
+    void Sort() {
+        if (sorted == ids.size()) return;
+        std::vector<std::pair<uint8_t, uint32_t>> entries(ids.size());
+        for (size_t i = 0; i < ids.size(); i++) entries[i] = std::make_pair(lengths[i], ids[i]);
+        auto byLength = [](const std::pair<uint8_t, uint32_t> &a, const std::pair<uint8_t, uint32_t> &b) {
+            return a.first < b.first;
+        };
+        std::stable_sort(entries.begin() + sorted, entries.end(), byLength);
+        std::inplace_merge(entries.begin(), entries.begin() + sorted, entries.end(), byLength);
+        for (size_t i = 0; i < ids.size(); i++) {
+            lengths[i] = entries[i].first;
+            ids[i] = entries[i].second;
+        }
+        sorted = ids.size();
+    }
+
+    // Drops the ids keep(id) rejects, keeping the order of the others; lengthOf(id) rebuilds the range.
+    template<typename Keep, typename LengthOf>
+    void Filter(Keep keep, LengthOf lengthOf) {
+        size_t out = 0, sortedOut = 0;
+        range = LengthRange();
+        for (size_t i = 0; i < ids.size(); i++) {
+            if (!keep(ids[i])) continue;
+            if (i < sorted) sortedOut++;
+            range.Add(lengthOf(ids[i]));
+            ids[out] = ids[i];
+            lengths[out++] = lengths[i];
+        }
+        ids.resize(out);
+        lengths.resize(out);
+        sorted = sortedOut;
+    }
+
+    template<class Archive>
+    void serialize(Archive &ar) {
+        ar(ids, lengths, sorted, range);
+    }
+};
+
 class SuggestionStage {
 private:
-    std::unordered_map<int, Entry> Deletes;
+    std::unordered_map<uint64_t, Entry> Deletes;
     ChunkArray<Node> Nodes;
 
 public:
@@ -266,7 +328,7 @@ public:
         Nodes.Clear();
     }
 
-    void Add(int deleteHash, xstring suggestion) {
+    void Add(uint64_t deleteHash, uint32_t suggestion) {
         auto deletesFinded = Deletes.find(deleteHash);
         Entry newEntry{};
         newEntry.count = 0;
@@ -277,39 +339,40 @@ public:
         entry.first = Nodes.Count;
         Deletes[deleteHash] = entry;
         Node item;
-        item.suggestion = std::move(suggestion);
+        item.suggestion = suggestion;
         item.next = next; // 1st semantic errors, this should not be Nodes.Count
         Nodes.Add(item);
     }
 
-    void CommitTo(std::shared_ptr<std::unordered_map<int, std::vector<xstring>>> permanentDeletes) {
-        auto permanentDeletesEnd = permanentDeletes->end();
-        for (auto &Delete : Deletes) {
-            auto permanentDeletesFinded = permanentDeletes->find(Delete.first);
-            std::vector<xstring> suggestions;
-            int i;
-            if (permanentDeletesFinded != permanentDeletesEnd) {
-                suggestions = permanentDeletesFinded->second;
-                i = suggestions.size();
-
-                std::vector<xstring> newSuggestions;
-                newSuggestions.reserve(suggestions.size() + Delete.second.count);
-                std::copy(suggestions.begin(), suggestions.end(), back_inserter(newSuggestions));
-                suggestions = newSuggestions;
-            } else {
-                i = 0;
-                int32_t count = Delete.second.count;
-                suggestions.reserve(count);
-            }
+    // Visits every staged bucket as (deleteHash, entry).
+    template<typename Fn>
+    void ForEachBucket(Fn fn) {
+        for (auto &Delete : Deletes) fn(Delete.first, Delete.second);
+    }
 
-            int next = Delete.second.first;
-            while (next >= 0) {
-                auto node = Nodes.At(next);
-                suggestions.push_back(node.suggestion);
-                next = node.next;
-                ++i;
+    // Visits the suggestions of one staged bucket in the order CommitTo appends them.
+    template<typename Fn>
+    void ForEachSuggestion(const Entry &entry, Fn fn) {
+        int next = entry.first;
+        while (next >= 0) {
+            auto &node = Nodes.At(next);
+            fn(node.suggestion);
+            next = node.next;
+        }
+    }
+
+    // Appends the staged suggestions to the buckets in place: the cost is the number of staged deletes, the
+    // existing suggestions of a bucket are neither copied nor moved (beyond the vector's own amortized growth).
+    // lengthOf(id) gives the length of a suggestion, for the length range of its bucket.
+    template<typename LengthOf>
+    void CommitTo(std::unordered_map<uint64_t, DeleteBucket> &permanentDeletes, LengthOf lengthOf) {
+        for (auto &Delete : Deletes) {
+            DeleteBucket &bucket = permanentDeletes[Delete.first];
+            if (bucket.ids.empty()) {
+                bucket.ids.reserve(Delete.second.count);
+                bucket.lengths.reserve(Delete.second.count);
             }
-            (*permanentDeletes)[Delete.first] = suggestions;
+            ForEachSuggestion(Delete.second, [&](uint32_t id) { bucket.Add(id, lengthOf(id)); });
         }
     }
 };
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include "FlatArray.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// Binary index image: an 8 byte magic, a format version and a byte order mark, followed by a flat
+// sequence of records. Every record starts on an 8 byte boundary; arrays are written as
+// (element count, element size, raw elements) so they can be used in place from a read-only mapping.
+namespace IndexImage {
+    static const char Magic[8] = {'S', 'Y', 'M', 'S', 'P', 'I', 'D', 'X'};
+    static const uint32_t Version = 6;
+    static const uint32_t ByteOrderMark = 0x01020304;
+
+    class Writer {
+    private:
+        std::ofstream out;
+        uint64_t position = 0;
+
+        void Raw(const void *data, size_t size) {
+            out.write(static_cast<const char *>(data), size);
+            position += size;
+        }
+
+        void Pad() {
+            static const char zeros[8] = {0};
+            if (position % 8 != 0) Raw(zeros, 8 - position % 8);
+        }
+
+    public:
+        explicit Writer(const std::string &path) : out(path, std::ios::binary | std::ios::trunc) {
+            if (!out.is_open()) return;
+            Raw(Magic, sizeof(Magic));
+            Raw(&Version, sizeof(Version));
+            Raw(&ByteOrderMark, sizeof(ByteOrderMark));
+        }
+
+        bool IsOpen() const { return out.is_open(); }
+
+        bool Good() const { return out.good(); }
+
+        void Scalar(int64_t value) {
+            Raw(&value, sizeof(value));
+        }
+
+        template<class T>
+        void Array(const FlatArray<T> &array) {
+            uint64_t header[2] = {array.size(), sizeof(T)};
+            Raw(header, sizeof(header));
+            Raw(array.data(), array.size() * sizeof(T));
+            Pad();
+        }
+    };
+
+    class Reader {
+    private:
+        const char *base;
+        uint64_t size;
+        uint64_t position = 0;
+
+        const char *Take(uint64_t bytes) {
+            if (bytes > size - position) throw std::invalid_argument("Index image is truncated.");
+            const char *at = base + position;
+            position += bytes;
+            return at;
+        }
+
+    public:
+        Reader(const char *base, uint64_t size) : base(base), size(size) {
+            if (size < sizeof(Magic) + 8 || std::memcmp(base, Magic, sizeof(Magic)) != 0)
+                throw std::invalid_argument("File is not a SymSpell index image.");
+            uint32_t version, byteOrder;
+            std::memcpy(&version, base + 8, sizeof(version));
+            std::memcpy(&byteOrder, base + 12, sizeof(byteOrder));
+            if (byteOrder != ByteOrderMark)
+                throw std::invalid_argument("Index image was written with a different byte order.");
+            if (version != Version)
+                throw std::invalid_argument("Unsupported index image version.");
+            position = 16;
+        }
+
+        int64_t Scalar() {
+            int64_t value;
+            std::memcpy(&value, Take(sizeof(value)), sizeof(value));
+            return value;
+        }
+
+        // Points the array at its records inside the image, no copy is made.
+        template<class T>
+        void Array(FlatArray<T> &array) {
+            uint64_t header[2];
+            std::memcpy(header, Take(sizeof(header)), sizeof(header));
+            if (header[1] != sizeof(T))
+                throw std::invalid_argument("Index image element size mismatch.");
+            if (header[0] > (size - position) / sizeof(T)) throw std::invalid_argument("Index image is truncated.");
+            const char *data = Take(header[0] * sizeof(T));
+            Take((8 - position % 8) % 8);
+            array.View(reinterpret_cast<const T *>(data), header[0]);
+        }
+    };
+
+    // Read-only memory mapping of a whole file, unmapped on destruction.
+    class MappedFile {
+    private:
+        const char *data = nullptr;
+        uint64_t size = 0;
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+#endif
+
+    public:
+        explicit MappedFile(const std::string &path) {
+#ifdef _WIN32
+            file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE) return;
+            LARGE_INTEGER fileSize;
+            if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) return;
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping == nullptr) return;
+            data = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            if (data != nullptr) size = fileSize.QuadPart;
+#else
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0) return;
+            struct stat st;
+            if (fstat(fd, &st) == 0 && st.st_size > 0) {
+                void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+                if (mapped != MAP_FAILED) {
+                    data = static_cast<const char *>(mapped);
+                    size = st.st_size;
+                }
+            }
+            close(fd);
+#endif
+        }
+
+        MappedFile(const MappedFile &) = delete;
+
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        ~MappedFile() {
+#ifdef _WIN32
+            if (data != nullptr) UnmapViewOfFile(data);
+            if (mapping != nullptr) CloseHandle(mapping);
+            if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+            if (data != nullptr) munmap(const_cast<char *>(data), size);
+#endif
+        }
+
+        bool IsOpen() const { return data != nullptr; }
+
+        const char *Data() const { return data; }
+
+        uint64_t Size() const { return size; }
+    };
+}
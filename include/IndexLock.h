@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Reader/writer lock of one dictionary. Lookups hold it shared, anything that changes the dictionary holds it
+// exclusively. The locks a thread holds are tracked per thread, so a public method that calls another one (a
+// loader adding entries, a segmentation running lookups) does not lock again, and the workers of a batch borrow
+// the lock of the thread that started the batch instead of queueing behind a waiting writer.
+// Only writers pay for the lock: a reader announces itself on a counter of its own cache line and checks that
+// no writer is active, so concurrent lookups never touch a shared mutex or counter. A writer raises the writing
+// flag, which turns new readers away to wait on the writer mutex, then waits for the counters to drain. Writers
+// go first: a steady stream of lookups cannot starve a change.
+class IndexLock {
+public:
+    enum Mode { Shared, Exclusive, Borrowed };
+
+    class Guard {
+    public:
+        Guard(const IndexLock &owner, Mode mode) : lock(&owner), mode(mode) {
+            auto &held = Held();
+            for (auto &entry : held) {
+                if (entry.first != lock) continue;
+                if (mode == Exclusive && entry.second != Exclusive)
+                    throw std::logic_error("A shared index lock cannot be upgraded.");
+                lock = nullptr;
+                return;
+            }
+            if (mode == Shared) owner.LockShared();
+            else if (mode == Exclusive) owner.Lock();
+            held.emplace_back(lock, mode == Exclusive ? Exclusive : Shared);
+        }
+
+        ~Guard() {
+            if (lock == nullptr) return;
+            auto &held = Held();
+            for (size_t i = held.size(); i-- > 0;) {
+                if (held[i].first != lock) continue;
+                held.erase(held.begin() + i);
+                break;
+            }
+            if (mode == Shared) lock->UnlockShared();
+            else if (mode == Exclusive) lock->Unlock();
+        }
+
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+
+    private:
+        const IndexLock *lock; // null when the thread already held it
+        Mode mode;
+    };
+
+private:
+    static const size_t ReaderSlots = 64;
+
+    // one counter per cache line, so readers on different slots never share a line
+    struct ReaderSlot {
+        std::atomic<uint32_t> count{0};
+        char padding[64 - sizeof(std::atomic<uint32_t>)];
+    };
+
+    static std::vector<std::pair<const IndexLock *, Mode>> &Held() {
+        thread_local std::vector<std::pair<const IndexLock *, Mode>> held;
+        return held;
+    }
+
+    // slot of the calling thread, handed out round robin as threads first read
+    static ReaderSlot &SlotOf(ReaderSlot *slots) {
+        static std::atomic<size_t> nextSlot(0);
+        thread_local size_t slot = nextSlot++ % ReaderSlots;
+        return slots[slot];
+    }
+
+    void LockShared() const {
+        ReaderSlot &slot = SlotOf(readers);
+        while (true) {
+            slot.count.fetch_add(1, std::memory_order_seq_cst);
+            if (!writing.load(std::memory_order_seq_cst)) return;
+            // a writer is active or waiting: step back and queue behind it
+            slot.count.fetch_sub(1, std::memory_order_release);
+            std::lock_guard<std::mutex> wait(writer);
+        }
+    }
+
+    void UnlockShared() const {
+        SlotOf(readers).count.fetch_sub(1, std::memory_order_release);
+    }
+
+    void Lock() const {
+        writer.lock();
+        writing.store(true, std::memory_order_seq_cst);
+        for (const ReaderSlot &slot : readers) {
+            for (int spins = 0; slot.count.load(std::memory_order_seq_cst) != 0; spins++) {
+                if (spins < 64) std::this_thread::yield();
+                else std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+    }
+
+    void Unlock() const {
+        writing.store(false, std::memory_order_release);
+        writer.unlock();
+    }
+
+    mutable ReaderSlot readers[ReaderSlots];
+    mutable std::atomic<bool> writing{false};
+    mutable std::mutex writer;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Number of dictionary words of every length, so that the longest length is known without a scan of
+// the words when the longest word is removed, and a lookup knows whether any word is near its length.
+class LengthHistogram {
+private:
+    std::vector<uint32_t> counts; // counts[len], no trailing zeros
+
+public:
+    void Add(int len) {
+        if ((size_t) len >= counts.size()) counts.resize(len + 1, 0);
+        counts[len]++;
+    }
+
+    void Remove(int len) {
+        if ((size_t) len >= counts.size() || counts[len] == 0) return;
+        counts[len]--;
+        while (!counts.empty() && counts.back() == 0) counts.pop_back();
+    }
+
+    uint32_t Count(int len) const { return len >= 0 && (size_t) len < counts.size() ? counts[len] : 0; }
+
+    // length of the longest word, 0 without words
+    int Max() const { return counts.empty() ? 0 : (int) counts.size() - 1; }
+
+    void Clear() { counts.clear(); }
+
+    // true when some word has a length in [minLen, maxLen]
+    bool Any(int minLen, int maxLen) const {
+        if (minLen < 0) minLen = 0;
+        for (int len = minLen; len <= maxLen && (size_t) len < counts.size(); len++)
+            if (counts[len] != 0) return true;
+        return false;
+    }
+};
+
+// Length of a word as stored next to its id in a delete bucket: lengths of 255 and more share the last
+// value, so a bucket sorted by these bytes is sorted by length up to 255.
+inline uint8_t LengthByte(int len) {
+    return len < UINT8_MAX ? (uint8_t) len : (uint8_t) UINT8_MAX;
+}
+
+// Shortest and longest suggestion length of one delete bucket, so a lookup can pass over a bucket whose
+// words are all too short or too long for the input without reading them. Lengths saturate at 65535, which
+// keeps the range an over-estimate: a bucket is never skipped when one of its words could match.
+struct LengthRange {
+    uint16_t min = UINT16_MAX;
+    uint16_t max = 0;
+
+    void Add(int len) {
+        uint16_t clamped = len < UINT16_MAX ? (uint16_t) len : (uint16_t) UINT16_MAX;
+        if (clamped < min) min = clamped;
+        if (clamped > max) max = clamped;
+    }
+
+    void Add(const LengthRange &other) {
+        if (other.min < min) min = other.min;
+        if (other.max > max) max = other.max;
+    }
+
+    // true when some length in the range may lie in [minLen, maxLen]
+    bool Overlaps(int minLen, int maxLen) const {
+        return max >= std::min(minLen, (int) UINT16_MAX) && min <= maxLen;
+    }
+
+    template<class Archive>
+    void serialize(Archive &ar) {
+        ar(min, max);
+    }
+};
@@ -7,6 +7,7 @@
 #include "BaseDistance.h"
 #include "BaseSimilarity.h"
 #include "Helpers.h"
+#include "BitParallel.h"
 #include "Defines.h"
 #include <vector>
 #include <cmath>
@@ -16,6 +17,7 @@
 class Levenshtein : public BaseDistance, BaseSimilarity {
 private:
     std::vector<int> baseChar1Costs;
+    BitParallel::PatternMasks patternMasks;
 
 public:
 
@@ -29,6 +31,11 @@ public:
     double Distance(const xstring& string1, const xstring& string2) override {
         if (string1.empty()) return string2.size();
         if (string2.empty()) return string1.size();
+        if (string1.size() <= BitParallel::MaxPatternLength) {
+            patternMasks.Set(string1.data(), string1.size());
+            return BitParallel::Levenshtein(patternMasks, string1.size(), string2.data(), string2.size(),
+                                            std::max(string1.size(), string2.size()));
+        }
 
         const xstring& str1 = (string1.size() > string2.size()) ? string2 : string1;
         const xstring& str2 = (string1.size() > string2.size()) ? string1 : string2;
@@ -52,6 +59,11 @@ public:
         const xstring& str2 = (string1.size() > string2.size()) ? string1 : string2;
 
         if (str2.size() - str1.size() > iMaxDistance) return -1;
+        if (string1.size() <= BitParallel::MaxPatternLength) {
+            // string1 is the pattern, so verifying one input against many strings builds its masks once
+            patternMasks.Set(string1.data(), string1.size());
+            return BitParallel::Levenshtein(patternMasks, string1.size(), string2.data(), string2.size(), iMaxDistance);
+        }
 
         int len1, len2, start;
         Helpers::PrefixSuffixPrep(str1, str2, len1, len2, start);
@@ -116,7 +128,7 @@ public:
 
     static int
     Distance(const xstring& string1, const xstring& string2, int len1, int len2, int start, std::vector<int> &char1Costs) {
-        for (int j = 0; j < len2;) char1Costs[j] = ++j;
+        for (int j = 0; j < len2; j++) char1Costs[j] = j + 1;
         int currentCharCost = 0;
         if (start == 0) {
             for (int i = 0; i < len1; ++i) {
@@ -157,7 +169,7 @@ public:
     static int Distance(const xstring& string1, const xstring& string2, int len1, int len2, int start, int maxDistance,
                         std::vector<int> &char1Costs) {
         int i, j;
-        for (j = 0; j < maxDistance;) char1Costs[j] = ++j;
+        for (j = 0; j < maxDistance; j++) char1Costs[j] = j + 1;
         for (; j < len2;) char1Costs[j++] = maxDistance + 1;
         int lenDiff = len2 - len1;
         int jStartOffset = maxDistance - lenDiff;
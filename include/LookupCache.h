@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "Defines.h"
+
+// Bounded, thread-safe least recently used cache of lookup results, keyed by term and an integer tag
+// (the lookup options). Keys are spread over shards that each have their own lock and LRU list, so
+// concurrent lookups rarely wait on each other. Invalidate() only bumps a generation: entries of an
+// older generation count as misses and are dropped when they are met or evicted.
+template<class Value>
+class LookupCache {
+public:
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        size_t size;
+        size_t capacity;
+    };
+
+    // capacity >= 1; small caches get fewer shards so that every shard can hold an entry
+    explicit LookupCache(size_t capacity) : capacity(capacity), shards(capacity < MaxShards ? capacity : MaxShards) {
+        for (size_t i = 0; i < shards.size(); i++)
+            shards[i].capacity = capacity / shards.size() + (i < capacity % shards.size() ? 1 : 0);
+    }
+
+    // true and the cached value when the key was stored since the last Invalidate
+    bool Get(const xstring &term, int64_t tag, Value &value) {
+        Key key{term, tag};
+        size_t hash = KeyHash()(key);
+        Shard &shard = shards[hash % shards.size()];
+        uint64_t current = generation.load(std::memory_order_acquire);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto found = shard.index.find(key);
+        if (found != shard.index.end()) {
+            if (found->second->generation == current) {
+                shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+                value = found->second->value;
+                hits.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            shard.entries.erase(found->second);
+            shard.index.erase(found);
+        }
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    void Put(const xstring &term, int64_t tag, const Value &value) {
+        Key key{term, tag};
+        size_t hash = KeyHash()(key);
+        Shard &shard = shards[hash % shards.size()];
+        uint64_t current = generation.load(std::memory_order_acquire);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto found = shard.index.find(key);
+        if (found != shard.index.end()) {
+            found->second->value = value;
+            found->second->generation = current;
+            shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+            return;
+        }
+        if (shard.index.size() >= shard.capacity) {
+            shard.index.erase(shard.entries.back().key);
+            shard.entries.pop_back();
+        }
+        shard.entries.push_front(Entry{key, value, current});
+        shard.index.emplace(std::move(key), shard.entries.begin());
+    }
+
+    // Makes every cached value stale; called whenever the dictionary changes.
+    void Invalidate() { generation.fetch_add(1, std::memory_order_acq_rel); }
+
+    void Clear() {
+        for (Shard &shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.entries.clear();
+            shard.index.clear();
+        }
+        hits = 0;
+        misses = 0;
+    }
+
+    Stats Statistics() {
+        size_t size = 0;
+        for (Shard &shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            size += shard.index.size();
+        }
+        return Stats{hits.load(), misses.load(), size, capacity};
+    }
+
+private:
+    static constexpr size_t MaxShards = 16;
+
+    struct Key {
+        xstring term;
+        int64_t tag;
+
+        bool operator==(const Key &other) const { return tag == other.tag && term == other.term; }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key &key) const { return std::hash<xstring>()(key.term) ^ (size_t) ((uint64_t) key.tag * 0x9E3779B97F4A7C15ull); }
+    };
+
+    struct Entry {
+        Key key;
+        Value value;
+        uint64_t generation;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::list<Entry> entries; // most recently used first
+        std::unordered_map<Key, typename std::list<Entry>::iterator, KeyHash> index;
+        size_t capacity = 0;
+    };
+
+    size_t capacity;
+    std::vector<Shard> shards;
+    std::atomic<uint64_t> generation{0};
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Parallel {
+public:
+    // Number of workers used for a request of `threads` (0 or less means one per hardware thread).
+    static int WorkerCount(int threads, size_t items) {
+        if (threads <= 0) threads = (int) std::thread::hardware_concurrency();
+        if (threads <= 0) threads = 1;
+        if ((size_t) threads > items) threads = (int) items;
+        return threads;
+    }
+
+    // Calls fn(i) for every i in [0, count) on the caller and up to threads - 1 helpers of a process wide
+    // pool. Everyone pulls indices from a shared counter, so uneven items balance out, and the caller works
+    // through the indices itself when the helpers are busy with another job, so nested or concurrent calls
+    // cannot deadlock. The first exception thrown by fn is rethrown on the caller.
+    template<typename Fn>
+    static void For(size_t count, int threads, Fn fn) {
+        int workers = WorkerCount(threads, count);
+        if (workers <= 1) {
+            for (size_t i = 0; i < count; i++) fn(i);
+            return;
+        }
+
+        // helpers that start after the caller returned find no index left, and never call fn
+        auto job = std::make_shared<Job>();
+        job->count = count;
+        job->fn = [&fn](size_t i) { fn(i); };
+        Pool &pool = Pool::Instance();
+        pool.Submit(workers - 1, [job]() { job->Work(); });
+        job->Work();
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->finished.wait(lock, [&]() { return job->done == job->count; });
+        if (job->error) std::rethrow_exception(job->error);
+    }
+
+private:
+    struct Job {
+        size_t count = 0;
+        std::function<void(size_t)> fn;
+        std::atomic<size_t> next{0};
+        std::atomic<bool> failed{false};
+        std::mutex mutex;
+        std::condition_variable finished;
+        size_t done = 0; // indices claimed and finished, guarded by mutex
+        std::exception_ptr error;
+
+        // every claimed index is counted as done, also the ones skipped after a failure
+        void Work() {
+            size_t finishedHere = 0;
+            for (size_t i = next++; i < count; i = next++) {
+                if (!failed) {
+                    try {
+                        fn(i);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if (!error) error = std::current_exception();
+                        failed = true;
+                    }
+                }
+                finishedHere++;
+            }
+            if (finishedHere == 0) return;
+            std::lock_guard<std::mutex> lock(mutex);
+            done += finishedHere;
+            if (done == count) finished.notify_all();
+        }
+    };
+
+    // Threads started on demand and kept for the life of the process. The pool is never destroyed, so
+    // process exit does not wait on (or tear down) threads that are blocked on the queue.
+    class Pool {
+    public:
+        static Pool &Instance() {
+            static Pool *pool = new Pool();
+            return *pool;
+        }
+
+        // queues copies of task for `helpers` threads, starting threads until there are that many
+        void Submit(int helpers, const std::function<void()> &task) {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (int h = 0; h < helpers; h++) tasks.push_back(task);
+            while (threads < helpers) {
+                std::thread(&Pool::Run, this).detach();
+                threads++;
+            }
+            ready.notify_all();
+        }
+
+    private:
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<std::function<void()>> tasks;
+        int threads = 0;
+
+        void Run() {
+            while (true) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    ready.wait(lock, [&]() { return !tasks.empty(); });
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+                task();
+            }
+        }
+    };
+};
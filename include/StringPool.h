@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include "Defines.h"
+#include "FlatArray.h"
+#include "IndexImage.h"
+
+// Interned string storage: every string lives once in a single contiguous character buffer and
+// is addressed by a stable 32-bit id (its index in the offset table).
+class StringPool {
+private:
+    FlatArray<xchar> chars;
+    FlatArray<uint32_t> offsets{0}; // string id occupies [offsets[id], offsets[id + 1]) in chars
+
+public:
+    StringPool() = default;
+
+    void Reserve(size_t strings, size_t characters) {
+        offsets.reserve(strings + 1);
+        chars.reserve(characters);
+    }
+
+    uint32_t Add(const xchar *s, size_t len) {
+        chars.append(s, s + len);
+        offsets.push_back(chars.size());
+        return offsets.size() - 2;
+    }
+
+    uint32_t Add(const xstring &s) { return Add(s.data(), s.size()); }
+
+    uint32_t Count() const { return offsets.size() - 1; }
+
+    int Length(uint32_t id) const { return offsets[id + 1] - offsets[id]; }
+
+    const xchar *Data(uint32_t id) const { return chars.data() + offsets[id]; }
+
+    xstring Get(uint32_t id) const { return xstring(Data(id), Length(id)); }
+
+    bool Equals(uint32_t id, const xstring &s) const {
+        return (size_t) Length(id) == s.size() && xstring::traits_type::compare(Data(id), s.data(), s.size()) == 0;
+    }
+
+    void Clear() {
+        chars.clear();
+        offsets.assign(1, 0);
+    }
+
+    void Save(IndexImage::Writer &image) const {
+        image.Array(chars);
+        image.Array(offsets);
+    }
+
+    void Map(IndexImage::Reader &image) {
+        image.Array(chars);
+        image.Array(offsets);
+        if (offsets.empty() || offsets.back() != chars.size())
+            throw std::invalid_argument("Index image has an inconsistent string pool.");
+    }
+
+    template<class Archive>
+    void serialize(Archive &ar) {
+        ar(chars, offsets);
+    }
+};
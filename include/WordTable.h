@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include "StringPool.h"
+#include "CharSignature.h"
+
+// Interning table for every term SymSpell knows about. Each distinct term is stored once in a
+// StringPool and gets a stable 32-bit id; counts and dictionary membership are kept per id, and an
+// open-addressing table of ids maps a term back to its id without storing the term a second time.
+// The CharSignature of every term is kept next to its count, for a cheap bound on edit distances.
+// Ids are never freed: a deleted or purged word, and a word only seen in bigrams, stays interned and gets
+// its old id back when it is added again. The table grows with the distinct terms ever seen, not with
+// repeated adding and deleting of the same terms; reload the dictionary to drop terms that are gone for good.
+class WordTable {
+public:
+    enum State : uint8_t {
+        Interned = 0,       // known string that is not (or no longer) a dictionary word
+        Dictionary = 1,     // word with count >= countThreshold
+        BelowThreshold = 2  // word seen with a count still below countThreshold
+    };
+
+    static const uint32_t NotFound = UINT32_MAX;
+
+private:
+    StringPool pool;
+    FlatArray<int64_t> counts;
+    FlatArray<uint8_t> states;
+    FlatArray<uint64_t> signatures;
+    FlatArray<uint32_t> slots; // id + 1 of the term hashed to this slot, 0 when empty
+    uint32_t slotMask = 0;
+    uint32_t dictionaryCount = 0;
+
+    static uint32_t Hash(const xchar *s, size_t len) {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < len; i++) {
+            hash ^= (uint32_t) s[i];
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    void Rehash(size_t capacity) {
+        slots.assign(capacity, 0);
+        slotMask = capacity - 1;
+        for (uint32_t id = 0; id < pool.Count(); id++) {
+            uint32_t i = Hash(pool.Data(id), pool.Length(id)) & slotMask;
+            while (slots[i] != 0) i = (i + 1) & slotMask;
+            slots[i] = id + 1;
+        }
+    }
+
+public:
+    WordTable() = default;
+
+    void Reserve(size_t words) {
+        size_t capacity = 16;
+        while (capacity * 3 < words * 4) capacity <<= 1;
+        if (capacity > slots.size()) Rehash(capacity);
+        counts.reserve(words);
+        states.reserve(words);
+        signatures.reserve(words);
+        pool.Reserve(words, words * 8);
+    }
+
+    uint32_t Find(const xchar *s, size_t len) const {
+        if (slots.empty()) return NotFound;
+        uint32_t i = Hash(s, len) & slotMask;
+        while (slots[i] != 0) {
+            uint32_t id = slots[i] - 1;
+            if ((size_t) pool.Length(id) == len && xstring::traits_type::compare(pool.Data(id), s, len) == 0) return id;
+            i = (i + 1) & slotMask;
+        }
+        return NotFound;
+    }
+
+    uint32_t Find(const xstring &s) const { return Find(s.data(), s.size()); }
+
+    // Returns the id of the term, adding it in the Interned state when it is not known yet.
+    uint32_t Intern(const xchar *s, size_t len) {
+        uint32_t id = Find(s, len);
+        if (id != NotFound) return id;
+        if ((pool.Count() + 1) * 4 > slots.size() * 3) Rehash(slots.empty() ? 16 : slots.size() * 2);
+        id = pool.Add(s, len);
+        counts.push_back(0);
+        states.push_back(Interned);
+        signatures.push_back(CharSignature::Of(s, len));
+        uint32_t i = Hash(s, len) & slotMask;
+        while (slots[i] != 0) i = (i + 1) & slotMask;
+        slots[i] = id + 1;
+        return id;
+    }
+
+    uint32_t Intern(const xstring &s) { return Intern(s.data(), s.size()); }
+
+    bool IsWord(uint32_t id) const { return id != NotFound && states[id] == Dictionary; }
+
+    uint32_t Size() const { return pool.Count(); }
+
+    uint32_t WordCount() const { return dictionaryCount; }
+
+    int Length(uint32_t id) const { return pool.Length(id); }
+
+    const xchar *Data(uint32_t id) const { return pool.Data(id); }
+
+    uint64_t Signature(uint32_t id) const { return signatures[id]; }
+
+    xstring Get(uint32_t id) const { return pool.Get(id); }
+
+    int64_t Count(uint32_t id) const { return counts[id]; }
+
+    void SetCount(uint32_t id, int64_t count) { counts[id] = count; }
+
+    State GetState(uint32_t id) const { return (State) states[id]; }
+
+    void SetState(uint32_t id, State state) {
+        if (states[id] == Dictionary) dictionaryCount--;
+        if (state == Dictionary) dictionaryCount++;
+        states[id] = state;
+    }
+
+    void Save(IndexImage::Writer &image) const {
+        pool.Save(image);
+        image.Array(counts);
+        image.Array(states);
+        image.Array(signatures);
+        image.Array(slots);
+        image.Scalar(slotMask);
+        image.Scalar(dictionaryCount);
+    }
+
+    void Map(IndexImage::Reader &image) {
+        pool.Map(image);
+        image.Array(counts);
+        image.Array(states);
+        image.Array(signatures);
+        image.Array(slots);
+        slotMask = image.Scalar();
+        dictionaryCount = image.Scalar();
+        // probing wraps around with slotMask, so it must cover exactly the slots, a power of two of them
+        if (counts.size() != pool.Count() || states.size() != pool.Count() || signatures.size() != pool.Count() ||
+            (!slots.empty() && (slots.size() != (size_t) slotMask + 1 || (slotMask & (slotMask + 1)) != 0)))
+            throw std::invalid_argument("Index image has an inconsistent word table.");
+        size_t used = 0;
+        for (size_t i = 0; i < slots.size(); i++) {
+            if (slots[i] == 0) continue;
+            if (slots[i] > pool.Count())
+                throw std::invalid_argument("Index image has a word table slot out of range.");
+            used++;
+        }
+        if (!slots.empty() && used == slots.size())
+            throw std::invalid_argument("Index image has an inconsistent word table.");
+    }
+
+    template<class Archive>
+    void serialize(Archive &ar) {
+        ar(pool, counts, states, signatures, slots, slotMask, dictionaryCount);
+    }
+};
@@ -9,39 +9,69 @@ namespace symspellcpppy
 
     int SymSpell::MaxDictionaryEditDistance() const
     {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
         return maxDictionaryEditDistance;
     }
 
     int SymSpell::PrefixLength() const
     {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
         return prefixLength;
     }
 
+    DeleteHasher SymSpell::Hasher() const
+    {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
+        return deleteHasher;
+    }
+
     int SymSpell::MaxLength() const
     {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
         return maxDictionaryWordLength;
     }
 
     long SymSpell::CountThreshold() const
     {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
         return countThreshold;
     }
 
     int SymSpell::WordCount()
     {
-        return words.size();
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
+        return words.WordCount();
+    }
+
+    bool SymSpell::HasEntries() const
+    {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
+        return (frozenDeletes != nullptr && frozenDeletes->BucketCount() > 0) || (deletes != nullptr && !deletes->empty());
     }
 
     int SymSpell::EntryCount()
     {
-        return deletes == nullptr ? 0 : deletes->size();
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
+        int count = frozenDeletes == nullptr ? 0 : frozenDeletes->BucketCount();
+        if (deletes != nullptr)
+        {
+            for (auto &bucket : *deletes)
+            {
+                if (frozenDeletes == nullptr || !frozenDeletes->Contains(bucket.first))
+                    count++;
+            }
+        }
+        return count;
     }
 
     SymSpell::SymSpell(int _maxDictionaryEditDistance, int _prefixLength, int _countThreshold, int _initialCapacity,
-                       unsigned char _compactLevel) : maxDictionaryEditDistance(_maxDictionaryEditDistance),
-                                                      prefixLength(_prefixLength),
-                                                      countThreshold(_countThreshold),
-                                                      initialCapacity(_initialCapacity)
+                       unsigned char _compactLevel, bool _frozenIndex,
+                       DeleteHasher _deleteHasher) : maxDictionaryEditDistance(_maxDictionaryEditDistance),
+                                                     prefixLength(_prefixLength),
+                                                     countThreshold(_countThreshold),
+                                                     initialCapacity(_initialCapacity),
+                                                     frozenIndex(_frozenIndex),
+                                                     deleteHasher(_deleteHasher)
     {
         if (_initialCapacity < 0)
             throw std::invalid_argument("initial_capacity is too small.");
@@ -54,132 +84,255 @@ namespace symspellcpppy
             throw std::invalid_argument("count_threshold cannot be negative");
         if (_compactLevel > 16)
             throw std::invalid_argument("compact_level cannot be greater than 16");
+        if (_deleteHasher != Fnv32 && _deleteHasher != Fnv64 && _deleteHasher != WyHash)
+            throw std::invalid_argument("Unknown delete hasher.");
 
         if (_compactLevel > 16)
             _compactLevel = 16;
         compactMask = (UINT_MAX >> (3 + _compactLevel)) << 2;
         maxDictionaryWordLength = 0;
-        words = std::unordered_map<xstring, int64_t>(initialCapacity);
+        words.Reserve(initialCapacity);
     }
 
     bool SymSpell::CreateDictionaryEntry(const xstring &key, int64_t count,
                                          const std::shared_ptr<SuggestionStage> &staging)
     {
+        IndexLock::Guard guard(indexLock, IndexLock::Exclusive);
+        InvalidateLookupCache();
+        uint32_t id;
+        if (!CountEntry(key.data(), key.size(), count, id))
+            return false;
+
+        // create deletes
+        if (staging != nullptr)
+        {
+            StageDeletes(id, *staging);
+        }
+        else
+        {
+            AppendDeletes(id);
+        }
+
+        return true;
+    }
 
+    bool SymSpell::CountEntry(const xchar *key, size_t len, int64_t count, uint32_t &id)
+    {
         if (count <= 0)
         {
             if (countThreshold > 0)
                 return false; // no point doing anything if count is zero, as it can't change anything
             count = 0;
         }
-        int countPrevious = -1;
-        auto belowThresholdWordsFinded = belowThresholdWords.find(key);
-        auto wordsFinded = words.find(key);
-        if (countThreshold > 1 && belowThresholdWordsFinded != belowThresholdWords.end())
+        int64_t countPrevious = -1;
+        id = words.Find(key, len);
+        WordTable::State state = (id == WordTable::NotFound) ? WordTable::Interned : words.GetState(id);
+        if (countThreshold > 1 && state == WordTable::BelowThreshold)
         {
-            countPrevious = belowThresholdWordsFinded->second;
+            countPrevious = words.Count(id);
             count = (MAXINT - countPrevious > count) ? countPrevious + count : MAXINT;
-            if (count >= countThreshold)
+            if (count < countThreshold)
             {
-                belowThresholdWords.erase(key);
-            }
-            else
-            {
-                belowThresholdWords[key] = count;
+                words.SetCount(id, count);
                 return false;
             }
         }
-        else if (wordsFinded != words.end())
+        else if (state == WordTable::Dictionary)
         {
-            countPrevious = wordsFinded->second;
+            countPrevious = words.Count(id);
             count = (MAXINT - countPrevious > count) ? countPrevious + count : MAXINT;
-            words.at(key) = count;
+            words.SetCount(id, count);
             return false;
         }
         else if (count < CountThreshold())
         {
-            belowThresholdWords[key] = count;
+            id = words.Intern(key, len);
+            words.SetCount(id, count);
+            words.SetState(id, WordTable::BelowThreshold);
             return false;
         }
 
-        words.insert(std::pair<xstring, int64_t>(key, count));
+        // a deleted word keeps its id in the frozen index until it is compacted, so compact before adding
+        // its deletes again rather than listing the word twice in its buckets
+        if (id != WordTable::NotFound && InFrozenIndex(id))
+            CompactIndex();
 
-        if (key.size() > maxDictionaryWordLength)
-            maxDictionaryWordLength = key.size();
+        id = words.Intern(key, len);
+        words.SetCount(id, count);
+        words.SetState(id, WordTable::Dictionary);
+        wordLengths.Add(len);
 
-        // create deletes
-        auto edits = EditsPrefix(key);
-        if (staging != nullptr)
+        if ((int) len > maxDictionaryWordLength)
+            maxDictionaryWordLength = (int) len;
+        return true;
+    }
+
+    bool SymSpell::InFrozenIndex(uint32_t id) const
+    {
+        if (frozenDeletes == nullptr)
+            return false;
+        // every word is listed in the bucket of its own prefix
+        int len = std::min(words.Length(id), prefixLength);
+        const xchar *chars = words.Data(id);
+        const uint32_t *begin, *end;
+        if (!frozenDeletes->Find(DeleteHash(chars, len, DeleteEnumerator::Fnv(chars, len)), begin, end))
+            return false;
+        return std::find(begin, end, id) != end;
+    }
+
+    void SymSpell::StageDeletes(uint32_t id, SuggestionStage &staging) const
+    {
+        thread_local DeleteEnumerator enumerator;
+        enumerator.ForEach(words.Data(id), words.Length(id), prefixLength, maxDictionaryEditDistance,
+                           [&](const xchar *chars, int len, uint32_t hash)
+                           { staging.Add(DeleteHash(chars, len, hash), id); });
+    }
+
+    void SymSpell::AppendDeletes(uint32_t id)
+    {
+        if (deletes == nullptr)
+            deletes = std::make_shared<std::unordered_map<uint64_t, DeleteBucket>>();
+        thread_local DeleteEnumerator enumerator;
+        int length = words.Length(id);
+        enumerator.ForEach(words.Data(id), length, prefixLength, maxDictionaryEditDistance,
+                           [&](const xchar *chars, int len, uint32_t hash)
+                           { (*deletes)[DeleteHash(chars, len, hash)].Add(id, length); });
+    }
+
+    void SymSpell::BuildDeletes(const std::vector<uint32_t> &newWords, int threads)
+    {
+        int workers = Parallel::WorkerCount(threads, newWords.size());
+        if (workers <= 1 && !frozenIndex)
         {
-            for (const auto &edit : *edits)
-            {
-                staging->Add(GetstringHash(edit), key);
-            }
+            // a committed stage appends every bucket's words newest first, so appending the words straight to
+            // their buckets from the last to the first gives the same buckets without the staging map
+            InvalidateLookupCache();
+            for (auto word = newWords.rbegin(); word != newWords.rend(); ++word)
+                AppendDeletes(*word);
+            return;
         }
-        else
+        if (workers <= 1)
         {
-
-            for (const auto &edit : *edits)
-            {
-                int deleteHash = GetstringHash(edit);
-                auto deletesFinded = deletes->find(deleteHash);
-                std::vector<xstring> suggestions;
-                if (deletesFinded != deletes->end())
-                {
-                    suggestions = deletesFinded->second;
-                    std::vector<xstring> newSuggestions;
-                    newSuggestions.reserve(suggestions.size() + 1);
-                    std::copy(suggestions.begin(), suggestions.end(), std::back_inserter(newSuggestions));
-                    deletes->at(deleteHash) = suggestions = newSuggestions;
-                }
-                else
-                {
-                    suggestions = std::vector<xstring>(1);
-                    deletes->insert(std::pair<int, std::vector<xstring>>(deleteHash, suggestions));
-                }
-                suggestions[suggestions.size() - 1] = key;
-            }
+            auto staging = std::make_shared<SuggestionStage>(16384);
+            for (uint32_t id : newWords)
+                StageDeletes(id, *staging);
+            CommitStaged(staging);
+            return;
         }
 
-        return true;
+        // every worker stages a contiguous chunk of the words
+        std::vector<std::unique_ptr<SuggestionStage>> stages(workers);
+        Parallel::For(workers, workers, [&](size_t t)
+                      {
+                          size_t begin = newWords.size() * t / workers, end = newWords.size() * (t + 1) / workers;
+                          stages[t].reset(new SuggestionStage(16384));
+                          for (size_t i = begin; i < end; i++)
+                              StageDeletes(newWords[i], *stages[t]); });
+
+        // a staged bucket lists its newest word first, so committing the last chunk first gives every
+        // bucket the order of a serial build
+        std::vector<SuggestionStage *> order;
+        for (int t = workers - 1; t >= 0; t--)
+            order.push_back(stages[t].get());
+        CommitStages(order, threads);
     }
 
     bool SymSpell::DeleteDictionaryEntry(const xstring &key)
     {
-        auto wordsFinded = words.find(key);
-        if (wordsFinded != words.end())
+        IndexLock::Guard guard(indexLock, IndexLock::Exclusive);
+        return DeleteDictionaryEntries({key}) == 1;
+    }
+
+    size_t SymSpell::DeleteDictionaryEntries(const std::vector<xstring> &keys)
+    {
+        IndexLock::Guard guard(indexLock, IndexLock::Exclusive);
+        std::vector<uint32_t> removed;
+        for (const xstring &key : keys)
         {
-            words.erase(wordsFinded);
-            if (wordsFinded->first.size() == maxDictionaryWordLength)
-            {
-                int max_size = 0;
-                for (auto &word : words)
-                {
-                    max_size = std::max(static_cast<int>(word.first.size()), max_size);
-                }
-                maxDictionaryWordLength = max_size;
-            }
-            auto edits = EditsPrefix(key);
-            for (const auto &edit : *edits)
+            uint32_t id = words.Find(key);
+            if (!words.IsWord(id))
+                continue;
+            words.SetState(id, WordTable::Interned);
+            words.SetCount(id, 0);
+            wordLengths.Remove(words.Length(id));
+            removed.push_back(id);
+        }
+        if (removed.empty())
+            return 0;
+        InvalidateLookupCache();
+        maxDictionaryWordLength = wordLengths.Max();
+
+        if (deletes != nullptr)
+        {
+            // every bucket of a removed word is filtered once, keeping the order of the remaining ids
+            std::vector<uint64_t> touched;
+            thread_local DeleteEnumerator enumerator;
+            for (uint32_t id : removed)
+                enumerator.ForEach(words.Data(id), words.Length(id), prefixLength, maxDictionaryEditDistance,
+                                   [&](const xchar *chars, int len, uint32_t hash)
+                                   { touched.push_back(DeleteHash(chars, len, hash)); });
+            std::sort(touched.begin(), touched.end());
+            touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+            for (uint64_t hash : touched)
             {
-                int deleteHash = GetstringHash(edit);
-                auto deletesFinded = deletes->find(deleteHash);
-                if (deletesFinded != deletes->end())
-                {
-                    auto delete_vec = deletesFinded->second;
-                    auto it = std::find(delete_vec.begin(), delete_vec.end(), key);
-                    if (it < delete_vec.end())
-                        delete_vec.erase(it);
-                }
+                auto bucket = deletes->find(hash);
+                if (bucket == deletes->end())
+                    continue;
+                bucket->second.Filter([&](uint32_t id)
+                                      { return words.IsWord(id); },
+                                      [&](uint32_t id)
+                                      { return words.Length(id); });
+                if (bucket->second.ids.empty())
+                    deletes->erase(bucket);
             }
-            return true;
         }
-        return false;
+
+        // the frozen index cannot change in place: lookups skip the ids of deleted words until it is compacted
+        if (frozenDeletes != nullptr)
+        {
+            frozenTombstones += std::count_if(removed.begin(), removed.end(), [&](uint32_t id)
+                                              { return InFrozenIndex(id); });
+            if (frozenTombstones * 8 > (size_t)words.WordCount())
+                CompactIndex();
+        }
+        return removed.size();
+    }
+
+    void SymSpell::CountWordLengths()
+    {
+        wordLengths.Clear();
+        for (uint32_t id = 0; id < words.Size(); id++)
+        {
+            if (words.IsWord(id))
+                wordLengths.Add(words.Length(id));
+        }
     }
 
-    bool
-    SymSpell::LoadBigramDictionary(const std::string &corpus, int termIndex, int countIndex, xchar separatorChars)
+    void SymSpell::CompactIndex()
     {
+        IndexLock::Guard guard(indexLock, IndexLock::Exclusive);
+        if (frozenDeletes == nullptr)
+            return;
+        InvalidateLookupCache();
+        auto compacted = std::make_shared<FrozenDeletes>();
+        compacted->Compact(*frozenDeletes, [&](uint32_t id)
+                           { return words.IsWord(id); },
+                           [&](uint32_t id)
+                           { return words.Length(id); });
+        frozenDeletes = compacted;
+        frozenTombstones = 0;
+    }
+
+    bool SymSpell::LoadBigramDictionary(const std::string &corpus, int termIndex, int countIndex,
+                                        xchar separatorChars, const MalformedLineHandler &onMalformed)
+    {
+        IndexLock::Guard guard(indexLock, IndexLock::Exclusive);
+#ifndef UNICODE_SUPPORT
+        IndexImage::MappedFile file(corpus);
+        if (file.IsOpen())
+            return LoadBigramDictionaryBuffer(file.Data(), file.Size(), termIndex, countIndex, separatorChars,
+                                              onMalformed);
+#endif
         xifstream corpusStream;
         corpusStream.open(corpus);
 #ifdef UNICODE_SUPPORT
@@ -189,55 +342,108 @@ namespace symspellcpppy
         if (!corpusStream.is_open())
             return false;
 
-        return LoadBigramDictionary(corpusStream, termIndex, countIndex, separatorChars);
+        return LoadBigramDictionary(corpusStream, termIndex, countIndex, separatorChars, onMalformed);
     }
 
-    bool SymSpell::LoadBigramDictionary(xifstream &corpusStream, int termIndex, int countIndex, xchar separatorChars)
+    bool SymSpell::LoadBigramDictionary(xifstream &corpusStream, int termIndex, int countIndex, xchar separatorChars,
+                                        const MalformedLineHandler &onMalformed)
     {
-        xstring line;
-        int linePartsLength = (separatorChars == DEFAULT_SEPARATOR_CHAR) ? 3 : 2;
-        while (getline(corpusStream, line))
-        {
-            std::vector<xstring> lineParts;
-            xstringstream ss(line);
-            xstring token;
-            while (getline(ss, token, separatorChars))
-                lineParts.push_back(token);
-            xstring key;
-            int64_t count;
+        IndexLock::Guard guard(indexLock, IndexLock::Exclusive);
+        xstring text = ReadAll(corpusStream);
+        return LoadBigramDictionaryBuffer(text.data(), text.size(), termIndex, countIndex, separatorChars,
+                                          onMalformed);
+    }
+
+    bool SymSpell::LoadBigramDictionaryBuffer(const xchar *text, size_t size, int termIndex, int countIndex,
+                                              xchar separatorChars, const MalformedLineHandler &onMalformed)
+    {
+        IndexLock::Guard guard(indexLock, IndexLock::Exclusive);
+        // with the default separator the two words of a bigram are separate columns
+        bool twoColumns = separatorChars == DEFAULT_SEPARATOR_CHAR;
+        size_t linePartsLength = twoColumns ? 3 : 2;
+        size_t columns = std::max(twoColumns ? termIndex + 2 : termIndex + 1, countIndex + 1);
+        std::vector<DelimitedText::Field> lineParts;
+        DelimitedText::ForEachLine(text, size, [&](const xchar *line, size_t length, size_t lineNumber)
+                                   {
+            DelimitedText::Split(line, length, separatorChars, lineParts);
+            const xchar *first, *second;
+            size_t firstLen, secondLen;
+            int64_t count = 1;
             if (lineParts.size() >= linePartsLength)
             {
-                key = (separatorChars == DEFAULT_SEPARATOR_CHAR) ? lineParts[termIndex] + XL(" ") +
-                                                                       lineParts[termIndex + 1]
-                                                                 : lineParts[termIndex];
-                try
+                if (lineParts.size() < columns)
+                {
+                    if (onMalformed)
+                        onMalformed(lineNumber, xstring(line, length), "missing column");
+                    return;
+                }
+                if (!DelimitedText::ParseCount(lineParts[countIndex].data, lineParts[countIndex].size, count))
                 {
-                    count = stoll(lineParts[countIndex]);
+                    if (onMalformed)
+                        onMalformed(lineNumber, xstring(line, length), "count is not a number");
+                    return;
                 }
-                catch (...)
+                const DelimitedText::Field &term = lineParts[termIndex];
+                if (twoColumns)
                 {
-                    printf("Cannot convert %s to integer\n", lineParts[countIndex].c_str());
+                    first = term.data;
+                    firstLen = term.size;
+                    second = lineParts[termIndex + 1].data;
+                    secondLen = lineParts[termIndex + 1].size;
+                }
+                else
+                {
+                    first = term.data;
+                    firstLen = term.size;
+                    second = nullptr;
                 }
             }
             else
             {
-                key = line;
-                count = 1;
+                // too few columns: the line itself is the bigram, counted once
+                first = line;
+                firstLen = length;
+                second = nullptr;
             }
-            std::pair<xstring, int64_t> element(key, count);
-            bigrams.insert(element);
+            if (second == nullptr)
+            {
+                // both words in one column, split at the first space
+                const xchar *space = DelimitedText::Traits::find(first, firstLen, XL(' '));
+                if (space != nullptr)
+                {
+                    second = space + 1;
+                    secondLen = first + firstLen - second;
+                    firstLen = space - first;
+                }
+            }
+            if (second == nullptr)
+            {
+                // empty lines are skipped silently, as by LoadDictionary
+                if (length > 0 && onMalformed)
+                    onMalformed(lineNumber, xstring(line, length), "missing second word");
+                return;
+            }
+            // both words are interned in the word table (as non-dictionary strings when they are not words yet),
+            // the bigram is stored under the pair of their ids
+            bigrams.Add(words.Intern(first, firstLen), words.Intern(second, secondLen), count);
             if (count < bigramCountMin)
-                bigramCountMin = count;
-        }
+                bigramCountMin = count; });
 
-        if (bigrams.empty())
+        if (bigrams.Size() == 0)
             return false;
         return true;
     }
 
-    bool SymSpell::LoadDictionary(const std::string &corpus, int termIndex, int countIndex, xchar separatorChars)
+    bool SymSpell::LoadDictionary(const std::string &corpus, int termIndex, int countIndex, xchar separatorChars,
+                                  int threads, const MalformedLineHandler &onMalformed)
     {
-
+        IndexLock::Guard guard(indexLock, IndexLock::Exclusive);
+#ifndef UNICODE_SUPPORT
+        IndexImage::MappedFile file(corpus);
+        if (file.IsOpen())
+            return LoadDictionaryBuffer(file.Data(), file.Size(), termIndex, countIndex, separatorChars, threads,
+                                        onMalformed);
+#endif
         xifstream corpusStream(corpus);
 #ifdef UNICODE_SUPPORT
         std::locale utf8(std::locale(), new std::codecvt_utf8<wchar_t>);
@@ -246,50 +452,83 @@ namespace symspellcpppy
         if (!corpusStream.is_open())
             return false;
 
-        return LoadDictionary(corpusStream, termIndex, countIndex, separatorChars);
+        return LoadDictionary(corpusStream, termIndex, countIndex, separatorChars, threads, onMalformed);
     }
 
-    bool SymSpell::LoadDictionary(xifstream &corpusStream, int termIndex, int countIndex, xchar separatorChars)
+    bool SymSpell::LoadDictionary(xifstream &corpusStream, int termIndex, int countIndex, xchar separatorChars,
+                                  int threads, const MalformedLineHandler &onMalformed)
     {
-        auto staging = std::make_shared<SuggestionStage>(16384);
-        xstring line;
-        int i = 0;
-        int start, end;
-        start = clock();
-        while (getline(corpusStream, line))
-        {
-            i++;
-            std::vector<xstring> lineParts;
-            xstringstream ss(line);
-            xstring token;
-            while (getline(ss, token, separatorChars))
-                lineParts.push_back(token);
+        IndexLock::Guard guard(indexLock, IndexLock::Exclusive);
+        xstring text = ReadAll(corpusStream);
+        return LoadDictionaryBuffer(text.data(), text.size(), termIndex, countIndex, separatorChars, threads,
+                                    onMalformed);
+    }
+
+    bool SymSpell::LoadDictionaryBuffer(const xchar *text, size_t size, int termIndex, int countIndex,
+                                        xchar separatorChars, int threads, const MalformedLineHandler &onMalformed)
+    {
+        IndexLock::Guard guard(indexLock, IndexLock::Exclusive);
+        std::vector<uint32_t> newWords;
+        uint32_t id;
+        size_t columns = std::max(termIndex, countIndex) + 1;
+        std::vector<DelimitedText::Field> lineParts;
+        DelimitedText::ForEachLine(text, size, [&](const xchar *line, size_t length, size_t lineNumber)
+                                   {
+            DelimitedText::Split(line, length, separatorChars, lineParts);
             if (lineParts.size() >= 2)
             {
-                int64_t count = 1;
-                try
-                {
-                    count = std::stoll(lineParts[countIndex]);
-                }
-                catch (const std::invalid_argument &)
+                if (lineParts.size() < columns)
                 {
-                    // Do nothing
+                    if (onMalformed)
+                        onMalformed(lineNumber, xstring(line, length), "missing column");
+                    return;
                 }
-                CreateDictionaryEntry(lineParts[termIndex], count, staging);
+                int64_t count = 1;
+                if (!DelimitedText::ParseCount(lineParts[countIndex].data, lineParts[countIndex].size, count) &&
+                    onMalformed)
+                    onMalformed(lineNumber, xstring(line, length), "count is not a number");
+                if (CountEntry(lineParts[termIndex].data, lineParts[termIndex].size, count, id))
+                    newWords.push_back(id);
             }
-            else
+            else if (length > 0)
             {
-                CreateDictionaryEntry(line, 1, staging);
-            }
-        }
-        CommitStaged(staging);
-        if (EntryCount() == 0)
+                // a line without separator is a word counted once
+                if (CountEntry(line, length, 1, id))
+                    newWords.push_back(id);
+            } });
+        BuildDeletes(newWords, threads);
+        if (!HasEntries())
             return false;
         return true;
     }
 
-    bool SymSpell::CreateDictionary(const std::string &corpus)
+    size_t SymSpell::CreateDictionaryEntries(const std::vector<std::pair<xstring, int64_t>> &entries, int threads)
     {
+        IndexLock::Guard guard(indexLock, IndexLock::Exclusive);
+        InvalidateLookupCache();
+        std::vector<uint32_t> newWords;
+        uint32_t id;
+        for (const auto &entry : entries)
+        {
+            if (CountEntry(entry.first.data(), entry.first.size(), entry.second, id))
+                newWords.push_back(id);
+        }
+        BuildDeletes(newWords, threads);
+        return newWords.size();
+    }
+
+    xstring SymSpell::ReadAll(xifstream &stream)
+    {
+        xstring text;
+        xchar buffer[16384];
+        while (stream.read(buffer, sizeof(buffer) / sizeof(xchar)) || stream.gcount() > 0)
+            text.append(buffer, stream.gcount());
+        return text;
+    }
+
+    bool SymSpell::CreateDictionary(const std::string &corpus, int threads)
+    {
+        IndexLock::Guard guard(indexLock, IndexLock::Exclusive);
         xifstream corpusStream;
         corpusStream.open(corpus);
 #ifdef UNICODE_SUPPORT
@@ -299,58 +538,250 @@ namespace symspellcpppy
         if (!corpusStream.is_open())
             return false;
 
-        return CreateDictionary(corpusStream);
+        return CreateDictionary(corpusStream, threads);
     }
 
-    bool SymSpell::CreateDictionary(xifstream &corpusStream)
+    bool SymSpell::CreateDictionary(xifstream &corpusStream, int threads)
     {
+        IndexLock::Guard guard(indexLock, IndexLock::Exclusive);
         xstring line;
-        auto staging = std::make_shared<SuggestionStage>(16384);
+        std::vector<uint32_t> newWords;
+        uint32_t id;
         while (getline(corpusStream, line))
         {
             for (const xstring &key : ParseWords(line))
             {
-                CreateDictionaryEntry(key, 1, staging);
+                if (CountEntry(key.data(), key.size(), 1, id))
+                    newWords.push_back(id);
             }
         }
-        CommitStaged(staging);
-        if (EntryCount() == 0)
+        BuildDeletes(newWords, threads);
+        if (!HasEntries())
             return false;
         return true;
     }
 
     void SymSpell::PurgeBelowThresholdWords()
     {
-        belowThresholdWords.clear();
+        IndexLock::Guard guard(indexLock, IndexLock::Exclusive);
+        InvalidateLookupCache();
+        for (uint32_t id = 0; id < words.Size(); id++)
+        {
+            if (words.GetState(id) == WordTable::BelowThreshold)
+            {
+                words.SetState(id, WordTable::Interned);
+                words.SetCount(id, 0);
+            }
+        }
     }
 
     void SymSpell::CommitStaged(const std::shared_ptr<SuggestionStage> &staging)
     {
+        IndexLock::Guard guard(indexLock, IndexLock::Exclusive);
+        CommitStages({staging.get()}, 1);
+    }
+
+    void SymSpell::CommitStages(const std::vector<SuggestionStage *> &stages, int threads)
+    {
+        IndexLock::Guard guard(indexLock, IndexLock::Exclusive);
+        InvalidateLookupCache();
+        if (frozenIndex)
+        {
+            // merge the previous frozen index, any unfrozen overlay and the staged deletes into a fresh index
+            auto frozen = std::make_shared<FrozenDeletes>();
+            frozen->Merge(frozenDeletes.get(), deletes.get(), stages, [&](uint32_t id)
+                          { return words.Length(id); },
+                          threads);
+            frozenDeletes = frozen;
+            deletes = nullptr;
+            return;
+        }
+        size_t stagedBuckets = 0;
+        for (SuggestionStage *stage : stages)
+            stagedBuckets += stage->DeleteCount();
         if (deletes == nullptr)
-            deletes = std::make_shared<std::unordered_map<int, std::vector<xstring>>>(staging->DeleteCount());
-        staging->CommitTo(deletes);
+            deletes = std::make_shared<std::unordered_map<uint64_t, DeleteBucket>>(stagedBuckets);
+
+        int workers = Parallel::WorkerCount(threads, stagedBuckets);
+        if (workers <= 1)
+        {
+            for (SuggestionStage *stage : stages)
+                stage->CommitTo(*deletes, [&](uint32_t id)
+                                { return words.Length(id); });
+            return;
+        }
+
+        // create all buckets up front, then let every worker append to the buckets of its own hash partition;
+        // mapped values of an unordered_map keep their address, so the workers never touch the map itself
+        struct StagedBucket
+        {
+            DeleteBucket *target;
+            SuggestionStage *stage;
+            const Entry *entry;
+        };
+        std::vector<std::vector<StagedBucket>> partitions(workers);
+        for (SuggestionStage *stage : stages)
+        {
+            stage->ForEachBucket([&](uint64_t hash, const Entry &entry)
+                                 { partitions[hash % workers].push_back(StagedBucket{&(*deletes)[hash], stage, &entry}); });
+        }
+        Parallel::For(workers, workers, [&](size_t w)
+                      {
+                          for (const StagedBucket &bucket : partitions[w])
+                          {
+                              if (bucket.target->ids.empty())
+                              {
+                                  bucket.target->ids.reserve(bucket.entry->count);
+                                  bucket.target->lengths.reserve(bucket.entry->count);
+                              }
+                              bucket.stage->ForEachSuggestion(*bucket.entry, [&](uint32_t id)
+                                                              { bucket.target->Add(id, words.Length(id)); });
+                          } });
     }
 
-    std::vector<SuggestItem> SymSpell::Lookup(const xstring &input, Verbosity verbosity)
+    bool SymSpell::SaveIndex(const std::string &path) const
     {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
+        std::shared_ptr<FrozenDeletes> index = frozenDeletes;
+        if (index == nullptr || (deletes != nullptr && !deletes->empty()))
+        {
+            index = std::make_shared<FrozenDeletes>();
+            index->Merge(frozenDeletes.get(), deletes.get(), {}, [&](uint32_t id)
+                         { return words.Length(id); });
+        }
+
+        IndexImage::Writer image(path);
+        if (!image.IsOpen())
+            return false;
+        image.Scalar(maxDictionaryEditDistance);
+        image.Scalar(prefixLength);
+        image.Scalar(countThreshold);
+        image.Scalar(compactMask);
+        image.Scalar((int64_t)distanceAlgorithm);
+        image.Scalar(maxDictionaryWordLength);
+        image.Scalar(bigramCountMin);
+        image.Scalar((int64_t)deleteHasher);
+        words.Save(image);
+        index->Save(image);
+        bigrams.Save(image);
+        return image.Good();
+    }
+
+    bool SymSpell::LoadIndex(const std::string &path)
+    {
+        IndexLock::Guard guard(indexLock, IndexLock::Exclusive);
+        auto file = std::make_shared<IndexImage::MappedFile>(path);
+        if (!file->IsOpen())
+            return false;
+
+        // map everything before touching this instance so a bad image leaves it unchanged
+        IndexImage::Reader image(file->Data(), file->Size());
+        int64_t header[8];
+        for (int64_t &value : header)
+            value = image.Scalar();
+        if (header[4] != DistanceAlgorithm::LevenshteinDistance && header[4] != DistanceAlgorithm::DamerauOSADistance)
+            throw std::invalid_argument("Index image has an unknown distance algorithm.");
+        if (header[7] != Fnv32 && header[7] != Fnv64 && header[7] != WyHash)
+            throw std::invalid_argument("Index image has an unknown delete hasher.");
+        WordTable mappedWords;
+        mappedWords.Map(image);
+        auto mappedDeletes = std::make_shared<FrozenDeletes>();
+        mappedDeletes->Map(image, mappedWords.Size());
+        BigramTable mappedBigrams;
+        mappedBigrams.Map(image);
+
+        maxDictionaryEditDistance = header[0];
+        prefixLength = header[1];
+        countThreshold = header[2];
+        compactMask = header[3];
+        distanceAlgorithm = (DistanceAlgorithm)header[4];
+        maxDictionaryWordLength = header[5];
+        bigramCountMin = header[6];
+        deleteHasher = (DeleteHasher)header[7];
+        words = std::move(mappedWords);
+        CountWordLengths();
+        bigrams = std::move(mappedBigrams);
+        frozenDeletes = mappedDeletes;
+        frozenTombstones = 0;
+        deletes = nullptr;
+        mappedIndex = file;
+        InvalidateLookupCache();
+        return true;
+    }
+
+    void SymSpell::EnableLookupCache(size_t capacity)
+    {
+        IndexLock::Guard guard(indexLock, IndexLock::Exclusive);
+        if (capacity == 0)
+            lookupCache.reset();
+        else
+            lookupCache.reset(new LookupCache<std::vector<SuggestItem>>(capacity));
+    }
+
+    void SymSpell::ClearLookupCache()
+    {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
+        if (lookupCache != nullptr)
+            lookupCache->Clear();
+    }
+
+    LookupCache<std::vector<SuggestItem>>::Stats SymSpell::LookupCacheStats() const
+    {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
+        if (lookupCache == nullptr)
+            return LookupCache<std::vector<SuggestItem>>::Stats{0, 0, 0, 0};
+        return lookupCache->Statistics();
+    }
+
+    void SymSpell::InvalidateLookupCache()
+    {
+        if (lookupCache != nullptr)
+            lookupCache->Invalidate();
+    }
+
+    std::vector<SuggestItem> SymSpell::Lookup(const xstring &input, Verbosity verbosity) const
+    {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
         return Lookup(input, verbosity, maxDictionaryEditDistance, false, false);
     }
 
-    std::vector<SuggestItem> SymSpell::Lookup(const xstring &input, Verbosity verbosity, int maxEditDistance)
+    std::vector<SuggestItem> SymSpell::Lookup(const xstring &input, Verbosity verbosity, int maxEditDistance) const
     {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
         return Lookup(input, verbosity, maxEditDistance, false, false);
     }
 
-    std::vector<SuggestItem> SymSpell::Lookup(const xstring &input, Verbosity verbosity, int maxEditDistance, bool includeUnknown)
+    std::vector<SuggestItem> SymSpell::Lookup(const xstring &input, Verbosity verbosity, int maxEditDistance, bool includeUnknown) const
     {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
         return Lookup(input, verbosity, maxEditDistance, includeUnknown, false);
     }
 
+    std::vector<SuggestItem>
+    SymSpell::Lookup(const xstring &input, Verbosity verbosity, int maxEditDistance, bool includeUnknown,
+                     bool transferCasing) const
+    {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
+        thread_local LookupContext context;
+        if (lookupCache == nullptr)
+            return Lookup(input, verbosity, maxEditDistance, includeUnknown, transferCasing, context);
+
+        int64_t tag = (int64_t) verbosity | (int64_t) maxEditDistance << 2 | (int64_t) includeUnknown << 34 |
+                      (int64_t) transferCasing << 35;
+        std::vector<SuggestItem> results;
+        if (lookupCache->Get(input, tag, results))
+            return results;
+        results = Lookup(input, verbosity, maxEditDistance, includeUnknown, transferCasing, context);
+        lookupCache->Put(input, tag, results);
+        return results;
+    }
+
     std::vector<SuggestItem>
     SymSpell::Lookup(const xstring &original_input, Verbosity verbosity, int maxEditDistance, bool includeUnknown,
-                     bool transferCasing)
+                     bool transferCasing, LookupContext &context) const
     {
-        if (deletes == nullptr)
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
+        if (deletes == nullptr && frozenDeletes == nullptr)
             return std::vector<SuggestItem>{}; // Dictionary is empty
 
         int skip = 0;
@@ -366,16 +797,19 @@ namespace symspellcpppy
 
         const xstring &input = transferCasing ? lower_input : original_input;
 
-        std::vector<SuggestItem> suggestions;
+        context.Reset(distanceAlgorithm);
+        std::vector<LookupContext::SuggestId> &suggestions = context.suggestions;
         int inputLen = input.size();
-        if (inputLen - maxEditDistance > maxDictionaryWordLength)
-            skip = 1;
+        uint64_t inputSignature = CharSignature::Of(input.data(), inputLen);
+        if (!wordLengths.Any(inputLen - maxEditDistance, inputLen + maxEditDistance))
+            skip = 1; // no word is within maxEditDistance of the input length
 
         int64_t suggestionCount = 0;
-        if (words.count(input) && !skip)
+        uint32_t inputId = words.Find(input);
+        if (words.IsWord(inputId) && !skip)
         {
-            suggestionCount = words.at(input);
-            suggestions.emplace_back(transferCasing ? original_input : input, 0, suggestionCount);
+            suggestionCount = words.Count(inputId);
+            suggestions.push_back(LookupContext::SuggestId{inputId, 0, suggestionCount});
             if (verbosity != All)
                 skip = 1;
         }
@@ -385,30 +819,50 @@ namespace symspellcpppy
 
         if (!skip)
         {
-            std::unordered_set<xstring> hashset1;
-            std::unordered_set<xstring> hashset2;
-            hashset2.insert(input);
+            std::unordered_set<xstring> &hashset1 = context.hashset1;
+            std::unordered_set<uint32_t> &hashset2 = context.hashset2; // input itself is skipped below
 
             int maxEditDistance2 = maxEditDistance;
-            int candidatePointer = 0;
-            std::deque<xstring> candidates;
+            size_t candidatePointer = 0;
 
             int inputPrefixLen = inputLen;
             if (inputPrefixLen > prefixLength)
-            {
                 inputPrefixLen = prefixLength;
-                candidates.emplace_back(input.substr(0, inputPrefixLen));
-            }
+            // deletes of prefixes that fit in 64 bits are queued as masks of deleted positions, and only
+            // spelled out in the single candidate buffer when they are taken from the queue
+            bool maskCandidates = inputPrefixLen <= 64;
+            if (maskCandidates)
+                context.BeginMasks(input.data(), inputPrefixLen);
             else
             {
-                candidates.emplace_back(input);
+                context.NextCandidate().assign(input, 0, inputPrefixLen);
+                context.candidateCount++;
             }
-            auto distanceComparer = EditDistance(distanceAlgorithm);
-            while (candidatePointer < candidates.size())
+            EditDistance &distanceComparer = context.distanceComparer;
+            while (candidatePointer < (maskCandidates ? context.maskCandidates.size() : context.candidateCount))
             {
-                const xstring &candidate = candidates[candidatePointer++];
+                xstring &candidate = context.candidate;
+                uint64_t candidateDeleted = 0;
+                uint32_t candidateFnv;
+                if (maskCandidates)
+                {
+                    candidateDeleted = context.maskCandidates[candidatePointer].deleted;
+                    candidateFnv = context.maskCandidates[candidatePointer++].fnv;
+                    candidate.clear();
+                    for (int p = 0; p < inputPrefixLen; p++)
+                        if (!(candidateDeleted >> p & 1))
+                            candidate.push_back(input[p]);
+                }
+                else
+                {
+                    // take the candidate out of its slot, the queue may grow while it is in use
+                    candidate.swap(context.candidates[candidatePointer++]);
+                    candidateFnv = DeleteEnumerator::Fnv(candidate.data(), candidate.size());
+                }
                 int candidateLen = candidate.size();
                 int lengthDiff = inputPrefixLen - candidateLen;
+                uint32_t candidateId = WordTable::NotFound;
+                bool candidateInterned = false; // candidateId is looked up on first use
 
                 if (lengthDiff > maxEditDistance2)
                 {
@@ -417,37 +871,102 @@ namespace symspellcpppy
                     break;
                 }
 
-                auto deletes_found = deletes->find(GetstringHash(candidate));
+                uint64_t deleteHash = DeleteHash(candidate.data(), candidateLen, candidateFnv);
+                // the lengths of the words that may pass the length checks of the first pass: not shorter than
+                // the candidate, within maxEditDistance2 of the input length, and without a prefix too long for
+                // the candidate (once the prefix of a word is longer than both the input prefix and the
+                // candidate plus maxEditDistance2, so are the prefixes of all longer words)
+                int minSuggestionLen = std::max(candidateLen, inputLen - maxEditDistance2);
+                int maxSuggestionLen = inputLen + maxEditDistance2;
+                int prefixLimit = std::max(inputPrefixLen, candidateLen + maxEditDistance2);
+                if (prefixLength > prefixLimit)
+                    maxSuggestionLen = std::min(maxSuggestionLen, prefixLimit);
+                uint8_t minLengthByte = LengthByte(minSuggestionLen), maxLengthByte = LengthByte(maxSuggestionLen);
+
+                // the ids of these lengths: a binary search of the length bytes of the sorted part of a bucket,
+                // and a byte by byte filter of the unsorted tail of a mutable bucket. Buckets whose length range
+                // misses the window are not read at all.
+                struct BucketSpan
+                {
+                    const uint32_t *ids;
+                    const uint8_t *lengths;
+                    uint32_t begin, end;
+                    bool filter;
+                };
+                BucketSpan buckets[3];
+                int bucketCount = 0;
+                auto addBucket = [&](const uint32_t *ids, const uint8_t *lengths, uint32_t sorted, uint32_t count)
+                {
+                    uint32_t begin = std::lower_bound(lengths, lengths + sorted, minLengthByte) - lengths;
+                    uint32_t end = std::upper_bound(lengths + begin, lengths + sorted, maxLengthByte) - lengths;
+                    if (begin < end)
+                        buckets[bucketCount++] = BucketSpan{ids, lengths, begin, end, false};
+                    if (sorted < count)
+                        buckets[bucketCount++] = BucketSpan{ids, lengths, sorted, count, true};
+                };
+                const uint32_t *frozenIds;
+                const uint8_t *frozenLengths;
+                uint32_t frozenCount;
+                LengthRange range;
+                if (frozenDeletes != nullptr &&
+                    frozenDeletes->Find(deleteHash, frozenIds, frozenLengths, frozenCount, range) &&
+                    range.Overlaps(minSuggestionLen, maxSuggestionLen))
+                    addBucket(frozenIds, frozenLengths, frozenCount, frozenCount);
+                if (deletes != nullptr)
+                {
+                    auto deletes_found = deletes->find(deleteHash);
+                    if (deletes_found != deletes->end() && deletes_found->second.range.Overlaps(minSuggestionLen, maxSuggestionLen))
+                    {
+                        const DeleteBucket &bucket = deletes_found->second;
+                        addBucket(bucket.ids.data(), bucket.lengths.data(), bucket.sorted, bucket.ids.size());
+                    }
+                }
 
-                // read candidate entry from std::unordered_map
-                if (deletes_found != deletes->end())
+                // read candidate entry: frozen span first, then the ids added after the last freeze.
+                // The first pass only applies the checks that do not depend on earlier suggestions; the second
+                // pass updates the suggestions from the entries that survived it, and computes their edit
+                // distances a batch at a time.
+                std::vector<LookupContext::Survivor> &survivors = context.survivors;
+                survivors.clear();
+                for (int b = 0; b < bucketCount; b++)
                 {
-                    for (const xstring &suggestion : deletes_found->second)
+                    const BucketSpan &bucket = buckets[b];
+                    for (uint32_t i = bucket.begin; i < bucket.end; i++)
                     {
-                        int suggestionLen = suggestion.size();
-                        if (suggestion == input)
+                        if (bucket.filter && (bucket.lengths[i] < minLengthByte || bucket.lengths[i] > maxLengthByte))
+                            continue;
+                        uint32_t suggestionId = bucket.ids[i];
+                        if (suggestionId == inputId || !words.IsWord(suggestionId))
                             continue;
+                        const xchar *suggestion = words.Data(suggestionId);
+                        int suggestionLen = words.Length(suggestionId);
                         if ((abs(suggestionLen - inputLen) >
                              maxEditDistance2) // input and sugg lengths diff > allowed/current best distance
                             || (suggestionLen <
-                                candidateLen) // sugg must be for a different delete string, in same bin only because of hash collision
-                            || (suggestionLen == candidateLen && suggestion !=
-                                                                     candidate)) // if sugg len = delete len, then it either equals delete or is in same bin only because of hash collision
+                                candidateLen)) // sugg must be for a different delete string, in same bin only because of hash collision
                             continue;
+                        if (suggestionLen == candidateLen)
+                        {
+                            // if sugg len = delete len, then it either equals delete or is in same bin only because of hash collision
+                            if (!candidateInterned)
+                            {
+                                candidateId = words.Find(candidate);
+                                candidateInterned = true;
+                            }
+                            if (suggestionId != candidateId)
+                                continue;
+                        }
                         auto suggPrefixLen = std::min(suggestionLen, prefixLength);
                         if (suggPrefixLen > inputPrefixLen &&
                             (suggPrefixLen - candidateLen) > maxEditDistance2)
                             continue;
 
-                        int distance = 0;
+                        int distance = LookupContext::Unverified;
                         int min_len = 0;
                         if (candidateLen == 0)
                         {
                             // suggestions which have no common chars with input (inputLen<=maxEditDistance && suggestionLen<=maxEditDistance)
                             distance = std::max(inputLen, suggestionLen);
-                            auto flag = hashset2.insert(suggestion);
-                            if (distance > maxEditDistance2 || !flag.second)
-                                continue;
                         }
                         else if (suggestionLen == 1)
                         {
@@ -455,98 +974,168 @@ namespace symspellcpppy
                                 distance = inputLen;
                             else
                                 distance = inputLen - 1;
-
-                            auto flag = hashset2.insert(suggestion);
-                            if (distance > maxEditDistance2 || !flag.second)
-                                continue;
                         }
-                        else if ((prefixLength - maxEditDistance == candidateLen) && (((min_len = std::min(inputLen, suggestionLen) - prefixLength) > 1) && (input.substr(inputLen + 1 - min_len) !=
-                                                                                                                                                             suggestion.substr(suggestionLen + 1 - min_len))) ||
+                        else if (CharSignature::LowerBound(inputSignature, words.Signature(suggestionId)) > maxEditDistance2)
+                        {
+                            // too many characters only one of the two words has: no need for the distance
+                            continue;
+                        }
+                        else if ((prefixLength - maxEditDistance == candidateLen) && (((min_len = std::min(inputLen, suggestionLen) - prefixLength) > 1) && (xstring::traits_type::compare(input.data() + inputLen + 1 - min_len,
+                                                                                                                                                                                               suggestion + suggestionLen + 1 - min_len, min_len - 1) != 0)) ||
                                  ((min_len > 0) && (input[inputLen - min_len] != suggestion[suggestionLen - min_len]) && ((input[inputLen - min_len - 1] != suggestion[suggestionLen - min_len]) || (input[inputLen - min_len] != suggestion[suggestionLen - min_len - 1]))))
                         {
                             continue;
                         }
-                        else
+                        else if (verbosity != All &&
+                                 !DeleteInSuggestionPrefix(candidate, candidateLen, suggestion, suggestionLen))
                         {
-                            if ((verbosity != All &&
-                                 !DeleteInSuggestionPrefix(candidate, candidateLen, suggestion, suggestionLen)) ||
-                                !hashset2.insert(suggestion).second)
-                                continue;
-                            distance = distanceComparer.Compare(input, suggestion, maxEditDistance2);
-                            if (distance < 0)
+                            continue;
+                        }
+                        survivors.push_back(LookupContext::Survivor{suggestionId, suggestionLen, suggestion, distance});
+                    } // end foreach
+                }     // end for buckets
+
+                // maxEditDistance2 may have shrunk since the first pass
+                auto outOfRange = [&](int suggestionLen)
+                {
+                    int suggPrefixLen = std::min(suggestionLen, prefixLength);
+                    return abs(suggestionLen - inputLen) > maxEditDistance2 ||
+                           (suggPrefixLen > inputPrefixLen && (suggPrefixLen - candidateLen) > maxEditDistance2);
+                };
+                for (size_t s = 0; s < survivors.size(); s++)
+                {
+                    if (outOfRange(survivors[s].length) || !hashset2.insert(survivors[s].id).second)
+                        continue;
+                    if (survivors[s].distance == LookupContext::Unverified)
+                    {
+                        // verify this survivor together with the next ones that may still need a distance
+                        context.verifyIndices.clear();
+                        context.verifyTexts.clear();
+                        context.verifyLengths.clear();
+                        for (size_t t = s; t < survivors.size() && context.verifyIndices.size() < LookupContext::BatchSize; t++)
+                        {
+                            const LookupContext::Survivor &next = survivors[t];
+                            if (next.distance != LookupContext::Unverified ||
+                                (t != s && (outOfRange(next.length) || hashset2.count(next.id) != 0)))
                                 continue;
+                            context.verifyIndices.push_back(t);
+                            context.verifyTexts.push_back(next.chars);
+                            context.verifyLengths.push_back(next.length);
                         }
+                        size_t count = context.verifyIndices.size();
+                        context.verifyDistances.resize(count);
+                        if (inputLen <= BitParallel::MaxPatternLength)
+                            context.batchDistance.Compare(distanceAlgorithm, input.data(), inputLen,
+                                                          context.verifyTexts.data(), context.verifyLengths.data(),
+                                                          count, maxEditDistance2, context.verifyDistances.data());
+                        else
+                            for (size_t v = 0; v < count; v++)
+                                context.verifyDistances[v] = distanceComparer.Compare(
+                                    input, xstring(context.verifyTexts[v], context.verifyLengths[v]), maxEditDistance2);
+                        for (size_t v = 0; v < count; v++)
+                            survivors[context.verifyIndices[v]].distance = context.verifyDistances[v];
+                    }
 
-                        if (distance <= maxEditDistance2)
+                    uint32_t suggestionId = survivors[s].id;
+                    int distance = survivors[s].distance;
+                    if (distance >= 0 && distance <= maxEditDistance2)
+                    {
+                        suggestionCount = words.Count(suggestionId);
+                        LookupContext::SuggestId si = LookupContext::SuggestId{suggestionId, distance, suggestionCount};
+                        if (!suggestions.empty())
                         {
-                            suggestionCount = words[suggestion];
-                            SuggestItem si = SuggestItem(suggestion, distance, suggestionCount);
-                            if (!suggestions.empty())
+                            switch (verbosity)
                             {
-                                switch (verbosity)
-                                {
-                                case Closest:
-                                {
-                                    if (distance < maxEditDistance2)
-                                        suggestions.clear();
-                                    break;
-                                }
-                                case Top:
+                            case Closest:
+                            {
+                                if (distance < maxEditDistance2)
+                                    suggestions.clear();
+                                break;
+                            }
+                            case Top:
+                            {
+                                if (distance < maxEditDistance2 || suggestionCount > suggestions[0].count)
                                 {
-                                    if (distance < maxEditDistance2 || suggestionCount > suggestions[0].count)
-                                    {
-                                        maxEditDistance2 = distance;
-                                        suggestions[0] = si;
-                                    }
-                                    continue;
-                                }
-                                case All:
-                                    break;
+                                    maxEditDistance2 = distance;
+                                    suggestions[0] = si;
                                 }
+                                continue;
+                            }
+                            case All:
+                                break;
                             }
-                            if (verbosity != All)
-                                maxEditDistance2 = distance;
-                            suggestions.push_back(si);
                         }
-                    } // end foreach
-                }     // end if
+                        if (verbosity != All)
+                            maxEditDistance2 = distance;
+                        suggestions.push_back(si);
+                    }
+                } // end for survivors
 
                 if ((lengthDiff < maxEditDistance) && (candidateLen <= prefixLength))
                 {
                     if (verbosity != All && lengthDiff >= maxEditDistance2)
                         continue;
 
+                    if (maskCandidates)
+                    {
+                        context.QueueDeletes(candidateDeleted);
+                        continue;
+                    }
                     for (int i = 0; i < candidateLen; i++)
                     {
-                        xstring del(candidate);
-                        del.erase(i, 1);
+                        xstring &del = context.NextCandidate();
+                        del.assign(candidate, 0, i);
+                        del.append(candidate, i + 1, xstring::npos);
 
                         if (hashset1.insert(del).second)
-                        {
-                            candidates.push_back(del);
-                        }
+                            context.candidateCount++;
                     }
                 }
             } // end while
 
             if (suggestions.size() > 1)
-                sort(suggestions.begin(), suggestions.end(), [](SuggestItem &l, SuggestItem &r)
-                     { return l.CompareTo(r) < 0 ? 1 : 0; });
+                sort(suggestions.begin(), suggestions.end(), [this](const LookupContext::SuggestId &l, const LookupContext::SuggestId &r)
+                     {
+                         if (l.distance != r.distance)
+                             return l.distance < r.distance;
+                         if (l.count != r.count)
+                             return l.count > r.count;
+                         int lLen = words.Length(l.id), rLen = words.Length(r.id);
+                         int cmp = xstring::traits_type::compare(words.Data(l.id), words.Data(r.id), std::min(lLen, rLen));
+                         return cmp != 0 ? cmp < 0 : lLen < rLen; });
+        }
 
-            if (transferCasing)
-            {
-                for (auto &suggestion : suggestions)
-                {
-                    suggestion.term = Helpers::transfer_casing_for_similar_text(original_input, suggestion.term);
-                }
-            }
+        // strings are only materialized for the returned suggestions
+        std::vector<SuggestItem> results;
+        results.reserve(suggestions.size());
+        for (const LookupContext::SuggestId &suggestion : suggestions)
+        {
+            if (suggestion.id == inputId)
+                results.emplace_back(transferCasing ? original_input : input, suggestion.distance, suggestion.count);
+            else
+                results.emplace_back(words.Get(suggestion.id), suggestion.distance, suggestion.count);
+            if (transferCasing && !skip)
+                results.back().term = Helpers::transfer_casing_for_similar_text(original_input, results.back().term);
         }
-        if (includeUnknown && (suggestions.empty()))
-            suggestions.emplace_back(input, maxEditDistance + 1, 0);
-        return suggestions;
+        if (includeUnknown && (results.empty()))
+            results.emplace_back(input, maxEditDistance + 1, 0);
+        return results;
     } // end if
 
-    bool SymSpell::DeleteInSuggestionPrefix(const xstring &deleteSugg, int deleteLen, xstring suggestion,
+    std::vector<std::vector<SuggestItem>>
+    SymSpell::LookupBatch(const std::vector<xstring> &inputs, Verbosity verbosity, int maxEditDistance, bool includeUnknown,
+                          bool transferCasing, int threads) const
+    {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
+        std::vector<std::vector<SuggestItem>> results(inputs.size());
+        Parallel::For(inputs.size(), threads, [&](size_t i)
+                      {
+                          IndexLock::Guard borrowed(indexLock, IndexLock::Borrowed);
+                          results[i] = Lookup(inputs[i], verbosity, maxEditDistance, includeUnknown, transferCasing); });
+        return results;
+    }
+
+    bool SymSpell::DeleteInSuggestionPrefix(const xstring &deleteSugg, int deleteLen, const xchar *suggestion,
                                             int suggestionLen) const
     {
         if (deleteLen == 0)
@@ -580,76 +1169,42 @@ namespace symspellcpppy
         return matches;
     }
 
-    std::shared_ptr<std::unordered_set<xstring>>
-    SymSpell::Edits(const xstring &word, int editDistance, std::shared_ptr<std::unordered_set<xstring>> deleteWords)
-    {
-        editDistance++;
-        if (word.size() > 1)
-        {
-            for (int i = 0; i < word.size(); i++)
-            {
-                xstring temp(word);
-                xstring del = temp.erase(i, 1);
-                if (deleteWords->insert(del).second)
-                {
-                    if (editDistance < maxDictionaryEditDistance)
-                        Edits(del, editDistance, deleteWords);
-                }
-            }
-        }
-        return deleteWords;
-    }
-
-    std::shared_ptr<std::unordered_set<xstring>> SymSpell::EditsPrefix(const xstring &key)
+    uint64_t SymSpell::DeleteHash(const xchar *chars, int len, uint32_t fnv) const
     {
-        auto m = std::make_shared<std::unordered_set<xstring>>();
-        if (key.size() <= maxDictionaryEditDistance)
-            m->insert(XL(""));
-        if (key.size() > prefixLength)
+        switch (deleteHasher)
         {
-            const xstring sub_key = key.substr(0, prefixLength);
-            m->insert(sub_key);
-            Edits(sub_key, 0, m);
+        case Fnv64:
+            return DeleteHashing::Fnv64(chars, len);
+        case WyHash:
+            return DeleteHashing::WyHash(chars, len);
+        default:
+            break;
         }
-        else
-        {
-            m->insert(key);
-            Edits(key, 0, m);
-        }
-        return m;
-    }
-
-    int SymSpell::GetstringHash(const xstring &s) const
-    {
-        int len = s.size();
         int lenMask = len;
         if (lenMask > 3)
             lenMask = 3;
 
-        unsigned int hash = 2166136261;
-        for (auto i = 0; i < len; i++)
-        {
-            hash ^= s[i];
-            hash *= 16777619;
-        }
-
+        unsigned int hash = fnv;
         hash &= compactMask;
         hash |= (unsigned int)lenMask;
-        return (int)hash;
+        return hash;
     }
 
-    std::vector<SuggestItem> SymSpell::LookupCompound(const xstring &input)
+    std::vector<SuggestItem> SymSpell::LookupCompound(const xstring &input) const
     {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
         return LookupCompound(input, maxDictionaryEditDistance, false);
     }
 
-    std::vector<SuggestItem> SymSpell::LookupCompound(const xstring &input, int editDistanceMax)
+    std::vector<SuggestItem> SymSpell::LookupCompound(const xstring &input, int editDistanceMax) const
     {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
         return LookupCompound(input, editDistanceMax, false);
     }
 
-    std::vector<SuggestItem> SymSpell::LookupCompound(const xstring &input, int editDistanceMax, bool transferCasing)
+    std::vector<SuggestItem> SymSpell::LookupCompound(const xstring &input, int editDistanceMax, bool transferCasing) const
     {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
         std::vector<xstring> termList1 = ParseWords(input);
 
         std::vector<SuggestItem> suggestions;     // suggestions for a single term
@@ -736,9 +1291,9 @@ namespace symspellcpppy
                                 }
 
                                 suggestionSplit.distance = distance2;
-                                if (bigrams.count(suggestionSplit.term) > 0)
+                                int64_t bigramCount;
+                                if (FindBigram(suggestions1[0].term, suggestions2[0].term, bigramCount))
                                 {
-                                    long bigramCount = bigrams.at(suggestionSplit.term);
                                     suggestionSplit.count = bigramCount;
                                     if (!suggestions.empty())
                                     {
@@ -819,118 +1374,515 @@ namespace symspellcpppy
         return suggestionsLine;
     }
 
-    Info SymSpell::WordSegmentation(const xstring &input)
+    std::vector<std::vector<SuggestItem>>
+    SymSpell::LookupCompoundBatch(const std::vector<xstring> &inputs, int editDistanceMax, bool transferCasing, int threads) const
+    {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
+        std::vector<std::vector<SuggestItem>> results(inputs.size());
+        Parallel::For(inputs.size(), threads, [&](size_t i)
+                      {
+                          IndexLock::Guard borrowed(indexLock, IndexLock::Borrowed);
+                          results[i] = LookupCompound(inputs[i], editDistanceMax, transferCasing); });
+        return results;
+    }
+
+    Info SymSpell::WordSegmentation(const xstring &input) const
     {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
         return WordSegmentation(input, MaxDictionaryEditDistance(), maxDictionaryWordLength);
     }
 
-    Info SymSpell::WordSegmentation(const xstring &input, int maxEditDistance)
+    Info SymSpell::WordSegmentation(const xstring &input, int maxEditDistance) const
     {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
         return WordSegmentation(input, maxEditDistance, maxDictionaryWordLength);
     }
 
-    Info SymSpell::WordSegmentation(const xstring &input, int maxEditDistance, int maxSegmentationWordLength)
+    Info SymSpell::WordSegmentation(const xstring &input, int maxEditDistance, int maxSegmentationWordLength) const
     {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
+        if (input.empty() || maxSegmentationWordLength <= 0)
+            return Info();
+        WordSegmentationStream stream(*this, maxEditDistance, maxSegmentationWordLength);
+        Info head = stream.Push(input);
+        Info tail = stream.Finish();
+        xstring segmented = head.getSegmented() + tail.getSegmented();
+        xstring corrected = head.getCorrected() + tail.getCorrected();
+        Info result;
+        result.set(segmented, corrected, stream.Distance(), stream.Probability());
+        return result;
+    }
+
+    std::vector<Info> SymSpell::WordSegmentationTopK(const xstring &input, int topK, int maxEditDistance,
+                                                     int maxSegmentationWordLength) const
+    {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
+        if (input.empty() || maxSegmentationWordLength <= 0 || topK <= 0)
+            return std::vector<Info>{};
+        WordSegmentationStream stream(*this, maxEditDistance, maxSegmentationWordLength, topK);
+        Info head = stream.Push(input);
+        std::vector<Info> results = stream.FinishTopK();
+        for (Info &result : results)
+        {
+            xstring segmented = head.getSegmented() + result.getSegmented();
+            xstring corrected = head.getCorrected() + result.getCorrected();
+            result.set(segmented, corrected, result.getDistance(), result.getProbability());
+        }
+        return results;
+    }
+
+    Info SymSpell::WordSegmentationBigrams(const xstring &input, int maxEditDistance,
+                                           int maxSegmentationWordLength) const
+    {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
+        if (input.empty() || maxSegmentationWordLength <= 0)
+            return Info();
+        // fed in chunks so that only the uncommitted tail of compositions (one per word length) is kept
+        const size_t chunkSize = 4096;
+        WordSegmentationStream stream(*this, maxEditDistance, maxSegmentationWordLength, 1, true);
+        xstring segmented, corrected;
+        for (size_t start = 0; start < input.size(); start += chunkSize)
+        {
+            Info piece = stream.Push(input.substr(start, chunkSize));
+            segmented += piece.getSegmented();
+            corrected += piece.getCorrected();
+        }
+        Info rest = stream.Finish();
+        segmented += rest.getSegmented();
+        corrected += rest.getCorrected();
+        Info result;
+        result.set(segmented, corrected, stream.Distance(), stream.Probability());
+        return result;
+    }
+
+    bool SymSpell::FindBigram(const xstring &word1, const xstring &word2, int64_t &count) const
+    {
+        uint32_t id1 = words.Find(word1);
+        if (id1 == WordTable::NotFound)
+            return false;
+        uint32_t id2 = words.Find(word2);
+        if (id2 == WordTable::NotFound)
+            return false;
+        return bigrams.Find(id1, id2, count);
+    }
+
+    int64_t SymSpell::BigramCount(const xstring &word1, const xstring &word2) const
+    {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
+        int64_t count;
+        return FindBigram(word1, word2, count) ? count : 0;
+    }
+
+    double SymSpell::BigramLogProbability(const xstring &previous, int64_t previousCount, const xstring &word,
+                                          int64_t wordCount) const
+    {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
+        int64_t count = BigramCount(previous, word);
+        double probability = count > 0 ? (double)count / (double)previousCount
+                                       : std::min((double)bigramCountMin / (double)previousCount,
+                                                  (double)wordCount / (double)N);
+        return log10(std::min(probability, 1.0));
+    }
+
+    std::vector<Info> SymSpell::WordSegmentationBatch(const std::vector<xstring> &inputs, int maxEditDistance,
+                                                      int maxSegmentationWordLength, int threads) const
+    {
+        IndexLock::Guard guard(indexLock, IndexLock::Shared);
+        std::vector<Info> results(inputs.size());
+        Parallel::For(inputs.size(), threads, [&](size_t i)
+                      {
+                          IndexLock::Guard borrowed(indexLock, IndexLock::Borrowed);
+                          results[i] = WordSegmentation(inputs[i], maxEditDistance, maxSegmentationWordLength); });
+        return results;
+    }
+
+
+    WordSegmentationStream::WordSegmentationStream(const SymSpell &symSpell, int maxEditDistance,
+                                                   int maxSegmentationWordLength, int beamWidth,
+                                                   bool bigramScoring) : symSpell(symSpell),
+                                                                         maxEditDistance(maxEditDistance),
+                                                                         maxSegmentationWordLength(maxSegmentationWordLength),
+                                                                         beamWidth(beamWidth),
+                                                                         bigramScoring(bigramScoring),
+                                                                         slots(bigramScoring ? maxSegmentationWordLength : beamWidth)
+    {
+        if (maxSegmentationWordLength <= 0)
+            throw std::invalid_argument("max_segmentation_word_length must be positive");
+        if (beamWidth <= 0)
+            throw std::invalid_argument("beam width must be positive");
+        if (bigramScoring && beamWidth != 1)
+            throw std::invalid_argument("bigram scoring cannot be combined with a beam");
+        Reset();
+    }
+
+    void WordSegmentationStream::Reset()
+    {
+        finished = false;
+        base = 0;
+        compactBase = 0;
+        text.clear();
+        compactIndex.assign(1, 0);
+        compact.clear();
+        compactLower.clear();
+        steps.assign(slots, Composition());
+        steps[0].filled = true; // the empty composition everything starts from
+        compositions.clear();
+        processed = 0;
+        committed = 0;
+        committedRank = 0;
+        distance = 0;
+        probability = 0;
+    }
+
+    Info WordSegmentationStream::Push(const xstring &chunk)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (finished)
+            Reset();
         // v6.7
         // normalize ligatures:
         // "scientific"
         // "scientiﬁc" "ﬁelds" "ﬁnal"
         // TODO: Figure out how to do the below utf-8 normalization in C++.
         // input = input.Normalize(System.Text.NormalizationForm.FormKC).Replace("\u002D", "");//.Replace("\uC2AD","");
-        int arraySize = std::min(maxSegmentationWordLength, (int)input.size());
-        std::vector<Info> compositions = std::vector<Info>(arraySize);
-        int circularIndex = -1;
 
-        for (int j = 0; j < input.size(); j++)
+        // Parts are looked up without their spaces. The input without spaces (and its lowercase copy) is built
+        // as it arrives, and compactIndex has the position of every input char in it, so the part
+        // input[start, end) without spaces is the range compactIndex[start]..compactIndex[end].
+        for (xchar c : chunk)
         {
-            int imax = std::min((int)input.size() - j, maxSegmentationWordLength);
-            for (int i = 1; i <= imax; i++)
+            text += c;
+            if (c != XL(' '))
             {
-                xstring part = input.substr(j, i);
-                int separatorLength = 0;
-                int topEd = 0;
-                double topProbabilityLog = 0;
-                xstring topResult;
-
-                if (isxspace(part[0]))
+                compact += c;
+                compactLower += to_xlower(c);
+            }
+            compactIndex.push_back(compactBase + compact.size());
+        }
+        int received = base + text.size();
+        while (processed + maxSegmentationWordLength <= received)
+            Score(maxSegmentationWordLength);
+
+        // The best compositions of the whole text will extend ones that end in the last maxSegmentationWordLength
+        // positions, so the words they all start with are final: commit up to their common ancestor.
+        int ancestor = processed, ancestorRank = 0;
+        int first = std::max(committed, processed - maxSegmentationWordLength + 1);
+        for (int end = processed; end >= first && ancestor > committed; end--)
+        {
+            for (int rank = 0; rank < slots; rank++)
+            {
+                int other = end, otherRank = rank;
+                if (!steps[(other - base) * slots + otherRank].filled)
+                    continue;
+                while (other != ancestor || otherRank != ancestorRank)
                 {
-                    part = part.substr(1);
+                    bool stepOther = other >= ancestor, stepAncestor = ancestor >= other;
+                    if (stepOther)
+                    {
+                        const Composition &step = steps[(other - base) * slots + otherRank];
+                        other = step.previous;
+                        otherRank = step.previousRank;
+                    }
+                    if (stepAncestor)
+                    {
+                        const Composition &step = steps[(ancestor - base) * slots + ancestorRank];
+                        ancestor = step.previous;
+                        ancestorRank = step.previousRank;
+                    }
                 }
-                else
+            }
+        }
+        return Commit(ancestor, ancestorRank);
+    }
+
+    Info WordSegmentationStream::Finish()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (finished)
+            Reset();
+        int received = base + text.size();
+        while (processed < received)
+            Score(std::min(received - processed, maxSegmentationWordLength));
+        Info rest = Commit(processed, BestRank(processed));
+        finished = true;
+        return rest;
+    }
+
+    std::vector<Info> WordSegmentationStream::FinishTopK()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (finished)
+            Reset();
+        int received = base + text.size();
+        while (processed < received)
+            Score(std::min(received - processed, maxSegmentationWordLength));
+        std::vector<Info> results;
+        if (processed > committed)
+        {
+            // with bigram scoring the slots hold one composition per last word length, only the best is returned
+            for (int rank = bigramScoring ? BestRank(processed) : 0; rank < (bigramScoring ? BestRank(processed) + 1 : slots); rank++)
+            {
+                const Composition &step = steps[(processed - base) * slots + rank];
+                if (!step.filled)
+                    break;
+                xstring segmented, corrected;
+                Words(processed, rank, segmented, corrected);
+                // different compositions can spell the same words (a part with or without its punctuation)
+                bool seen = false;
+                for (const Info &result : results)
+                    seen = seen || (result.getSegmented() == segmented && result.getCorrected() == corrected);
+                if (seen)
+                    continue;
+                results.emplace_back();
+                results.back().set(segmented, corrected, step.distance, step.probability);
+            }
+        }
+        else
+        {
+            results.emplace_back();
+            xstring empty;
+            results.back().set(empty, empty, distance, probability);
+        }
+        Commit(processed, BestRank(processed));
+        finished = true;
+        return results;
+    }
+
+    void WordSegmentationStream::Score(int imax)
+    {
+        int j = processed;
+        const Composition *circular = &steps[(j - base) * slots];
+        while ((int)compositions.size() < imax * slots)
+            compositions.emplace_back();
+        for (int i = 1; i <= imax; i++)
+        {
+            int start = j;
+            int separatorLength = 0;
+            if (isxspace(text[j - base]))
+                start++;
+            else
+                separatorLength = 1;
+            int partBegin = compactIndex[start - base], partEnd = compactIndex[j + i - base];
+            int partLen = partEnd - partBegin;
+            int topEd = (j + i - start) - partLen;
+            double topProbabilityLog = 0;
+            xstring topResult;
+            xstring term;      // dictionary word, for bigram scoring
+            int64_t count = 0;
+
+            // v6.7
+            // Lookup against the lowercase term
+            partLower.assign(compactLower, partBegin - compactBase, partLen);
+            std::vector<SuggestItem> results = symSpell.Lookup(partLower, Top, maxEditDistance);
+            if (!results.empty())
+            {
+                if (bigramScoring)
                 {
-                    separatorLength = 1;
+                    term = results[0].term;
+                    count = results[0].count;
                 }
-
-                topEd += part.size();
-                xregex r(XL(" "));
-                part = regex_replace(part, r, XL(""));
-                topEd -= part.size();
+                topResult = std::move(results[0].term);
 
                 // v6.7
-                // Lookup against the lowercase term
-                auto partLower = Helpers::string_lower(part);
-                std::vector<SuggestItem> results = Lookup(partLower, Top, maxEditDistance);
-                if (!results.empty())
+                // retain/preserve upper case
+                if (is_xupper(partLen > 0 ? compact[partBegin - compactBase] : XL('\0')))
                 {
-                    topResult = results[0].term;
+                    topResult[0] = to_xupper(topResult[0]);
+                }
 
-                    // v6.7
-                    // retain/preserve upper case
-                    if (is_xupper(part[0]))
+                topEd += results[0].distance;
+                topProbabilityLog = log10((double)results[0].count / (double)SymSpell::N);
+            }
+            else
+            {
+                topResult = compact.substr(partBegin - compactBase, partLen);
+                topEd += partLen;
+                topProbabilityLog = log10(10.0 / (SymSpell::N * pow(10.0, partLen)));
+            }
+
+            // v6.7
+            // keep punctuation or spostrophe adjacent to previous word
+            bool joined = j > 0 && (((topResult.size() == 1) && (is_xpunct(topResult[0]) > 0)) ||
+                                    ((topResult.size() == 2) && (topResult.rfind(XL("’"), 0) == 0)));
+            int separator = j == 0 || joined ? 0 : separatorLength;
+            int beam = (i - 1) * slots;
+
+            if (bigramScoring)
+            {
+                // Viterbi over the last word: the slot of the part's length at j + i keeps the best composition
+                // ending with this part, by edit distance without the inserted spaces, then probability
+                Composition &destination = compositions[beam + i - 1];
+                int bestRank = -1, bestEdits = 0;
+                double bestProbability = 0;
+                for (int rank = 0; rank < slots; rank++)
+                {
+                    const Composition &from = circular[rank];
+                    if (!from.filled)
+                        continue;
+                    int edits = from.distance - from.separators + topEd;
+                    double probability = from.probability + topProbabilityLog;
+                    if (j > 0 && count > 0 && from.count > 0)
+                        probability = from.probability + symSpell.BigramLogProbability(from.term, from.count, term, count);
+                    if (bestRank < 0 || edits < bestEdits || (edits == bestEdits && probability > bestProbability))
                     {
-                        topResult[0] = to_xupper(topResult[0]);
+                        bestRank = rank;
+                        bestEdits = edits;
+                        bestProbability = probability;
                     }
-
-                    topEd += results[0].distance;
-                    topProbabilityLog = log10((double)results[0].count / (double)N);
                 }
+                const Composition &from = circular[bestRank];
+                destination.filled = true;
+                destination.distance = from.distance + separator + topEd;
+                destination.separators = from.separators + separator;
+                destination.probability = bestProbability;
+                destination.previous = j;
+                destination.previousRank = bestRank;
+                destination.partBegin = partBegin;
+                destination.partEnd = partEnd;
+                destination.joined = joined;
+                destination.corrected = std::move(topResult);
+                destination.term = std::move(term);
+                destination.count = count;
+                continue;
+            }
+
+            Composition *destination = &compositions[beam];
+
+            // every composition of the beam at j is extended by the part; the one of the best composition
+            // replaces the best at j + i by the rules WordSegmentation always used
+            for (int rank = 0; rank < slots && circular[rank].filled; rank++)
+            {
+                const Composition &from = circular[rank];
+                bool best = rank == 0 &&
+                            (!destination->filled ||
+                             (((from.distance + topEd == destination->distance) || (from.distance + separatorLength + topEd == destination->distance)) && (destination->probability < from.probability + topProbabilityLog)) ||
+                             (from.distance + separatorLength + topEd < destination->distance));
+                if (!best && slots == 1)
+                    continue;
+
+                Composition candidate;
+                candidate.filled = true;
+                candidate.distance = from.distance + separator + topEd;
+                candidate.separators = from.separators + separator;
+                candidate.probability = from.probability + topProbabilityLog;
+                candidate.previous = j;
+                candidate.previousRank = rank;
+                candidate.partBegin = partBegin;
+                candidate.partEnd = partEnd;
+                candidate.joined = joined;
+                if (rank + 1 < slots && circular[rank + 1].filled)
+                    candidate.corrected = topResult;
                 else
+                    candidate.corrected = std::move(topResult);
+
+                if (best)
                 {
-                    topResult = part;
-                    topEd += part.size();
-                    topProbabilityLog = log10(10.0 / (N * pow(10.0, part.size())));
+                    std::swap(*destination, candidate);
+                    if (!candidate.filled)
+                        continue;
                 }
+                if (slots > 1)
+                    Keep(beam, std::move(candidate));
+            }
+        }
+        // nothing ends at j + 1 anymore
+        for (int rank = 0; rank < slots; rank++)
+        {
+            steps.push_back(std::move(compositions.front()));
+            compositions.pop_front();
+        }
+        processed++;
+    }
 
-                int destinationIndex = ((i + circularIndex) % arraySize);
+    int WordSegmentationStream::BestRank(int position) const
+    {
+        if (!bigramScoring)
+            return 0;
+        const Composition *beam = &steps[(position - base) * slots];
+        int best = 0;
+        for (int rank = 1; rank < slots; rank++)
+        {
+            if (!beam[rank].filled)
+                continue;
+            int edits = beam[rank].distance - beam[rank].separators;
+            int bestEdits = beam[best].distance - beam[best].separators;
+            if (edits < bestEdits || (edits == bestEdits && beam[rank].probability > beam[best].probability))
+                best = rank;
+        }
+        return best;
+    }
 
-                auto circular_distance = compositions[circularIndex].getDistance();
-                auto destination_distance = compositions[destinationIndex].getDistance();
-                auto circular_probablity = compositions[circularIndex].getProbability();
-                auto destination_probablity = compositions[destinationIndex].getProbability();
+    void WordSegmentationStream::Keep(int beam, Composition &&candidate)
+    {
+        // the places after the best are ranked by edit distance without the inserted spaces, then probability
+        int edits = candidate.distance - candidate.separators;
+        int rank = 1;
+        for (; rank < slots && compositions[beam + rank].filled; rank++)
+        {
+            const Composition &kept = compositions[beam + rank];
+            int keptEdits = kept.distance - kept.separators;
+            if (edits < keptEdits || (edits == keptEdits && candidate.probability > kept.probability))
+                break;
+        }
+        if (rank == slots)
+            return;
+        for (int last = slots - 1; last > rank; last--)
+            compositions[beam + last] = std::move(compositions[beam + last - 1]);
+        compositions[beam + rank] = std::move(candidate);
+    }
 
-                if (j == 0)
-                {
-                    compositions[destinationIndex].set(part, topResult, topEd, topProbabilityLog);
-                }
-                else if ((i == maxSegmentationWordLength) || (((circular_distance + topEd == destination_distance) || (circular_distance + separatorLength + topEd == destination_distance)) && (destination_probablity < circular_probablity + topProbabilityLog)) || (circular_distance + separatorLength + topEd < destination_distance))
-                {
-                    // v6.7
-                    // keep punctuation or spostrophe adjacent to previous word
-                    if (((topResult.size() == 1) && (is_xpunct(topResult[0]) > 0)) || ((topResult.size() == 2) &&
-                                                                                       (topResult.rfind(XL("’"), 0) ==
-                                                                                        0)))
-                    {
-                        xstring seg = compositions[circularIndex].getSegmented() + part;
-                        xstring correct = compositions[circularIndex].getCorrected() + topResult;
-                        int d = circular_distance + topEd;
-                        double prob = circular_probablity + topProbabilityLog;
-                        compositions[destinationIndex].set(seg, correct, d, prob);
-                    }
-                    else
-                    {
-                        xstring seg = compositions[circularIndex].getSegmented() + XL(" ") + part;
-                        xstring correct = compositions[circularIndex].getCorrected() + XL(" ") + topResult;
-                        int d = circular_distance + separatorLength + topEd;
-                        double prob = circular_probablity + topProbabilityLog;
-                        compositions[destinationIndex].set(seg, correct, d, prob);
-                    }
-                }
+    void WordSegmentationStream::Words(int end, int rank, xstring &segmented, xstring &corrected) const
+    {
+        // walk the back-pointers from end, then join the words front to back
+        std::vector<const Composition *> words;
+        while (end > committed)
+        {
+            const Composition &step = steps[(end - base) * slots + rank];
+            words.push_back(&step);
+            end = step.previous;
+            rank = step.previousRank;
+        }
+        for (auto word = words.rbegin(); word != words.rend(); ++word)
+        {
+            const Composition &step = **word;
+            if (step.previous > 0 && !step.joined)
+            {
+                segmented += XL(' ');
+                corrected += XL(' ');
             }
-            circularIndex++;
-            if (circularIndex == arraySize)
-                circularIndex = 0;
+            segmented.append(compact, step.partBegin - compactBase, step.partEnd - step.partBegin);
+            corrected += step.corrected;
         }
-        return compositions[circularIndex];
     }
 
+    Info WordSegmentationStream::Commit(int end, int rank)
+    {
+        xstring segmented, corrected;
+        Words(end, rank, segmented, corrected);
+        const Composition &step = steps[(end - base) * slots + rank];
+        Info piece;
+        piece.set(segmented, corrected, step.distance - distance, step.probability - probability);
+        distance = step.distance;
+        probability = step.probability;
+        committed = end;
+        committedRank = rank;
+        Trim();
+        return piece;
+    }
+
+    void WordSegmentationStream::Trim()
+    {
+        // everything before the committed words is done with; drop it once it is at least half of the buffers
+        int drop = committed - base;
+        if (drop == 0 || 2 * drop * slots < (int)steps.size())
+            return;
+        int compactDrop = compactIndex[drop] - compactBase;
+        text.erase(0, drop);
+        compactIndex.erase(compactIndex.begin(), compactIndex.begin() + drop);
+        steps.erase(steps.begin(), steps.begin() + drop * slots);
+        compact.erase(0, compactDrop);
+        compactLower.erase(0, compactDrop);
+        base += drop;
+        compactBase += compactDrop;
+    }
 }
@@ -21,10 +21,25 @@
 #include <locale>
 #include <regex>
 #include <iostream>
+#include <deque>
+#include <functional>
+#include <mutex>
 #include "unordered_set"
 #include "include/Defines.h"
 #include "include/Helpers.h"
 #include "include/EditDistance.h"
+#include "include/WordTable.h"
+#include "include/BigramTable.h"
+#include "include/FrozenDeletes.h"
+#include "include/IndexImage.h"
+#include "include/Parallel.h"
+#include "include/DeleteEnumerator.h"
+#include "include/BatchDistance.h"
+#include "include/LookupCache.h"
+#include "include/DelimitedText.h"
+#include "include/LengthHistogram.h"
+#include "include/DeleteHashing.h"
+#include "include/IndexLock.h"
 #include "cereal/types/unordered_map.hpp"
 #include "cereal/types/string.hpp"
 #include "cereal/types/vector.hpp"
@@ -60,13 +75,17 @@ namespace symspellcpppy
         rtrim(s);
     }
 
+    /// <summary>Called by the dictionary loaders for every line they cannot use as is, with its 1-based line
+    /// number, the line and the reason.</summary>
+    typedef std::function<void(size_t lineNumber, const xstring &line, const char *reason)> MalformedLineHandler;
+
     class Info
     {
     private:
         xstring segmentedstring;
         xstring correctedstring;
-        int distanceSum;
-        double probabilityLogSum;
+        int distanceSum = 0;
+        double probabilityLogSum = 0.0;
 
     public:
         void set(xstring &seg, xstring &cor, int d, double prob)
@@ -110,6 +129,172 @@ namespace symspellcpppy
         All
     };
 
+    /// <summary>Reusable scratch state for SymSpell::Lookup.</summary>
+    /// <remarks>Keeps the candidate queue, the visited sets and the edit distance cost vectors between calls,
+    /// so repeated lookups do not reallocate them. A context may only be used by one thread at a time;
+    /// the Lookup overloads without a context use one context per thread.</remarks>
+    class LookupContext
+    {
+        friend class SymSpell;
+
+    private:
+        // suggestion found by Lookup, kept as a word id until the results are returned
+        struct SuggestId
+        {
+            uint32_t id;
+            int distance;
+            int64_t count;
+        };
+
+        // delete candidate of an input prefix of at most 64 chars, as the set of deleted positions
+        struct MaskCandidate
+        {
+            uint64_t deleted;
+            uint32_t fnv;
+        };
+
+        struct VisitedSlot
+        {
+            uint32_t stamp; // slot is used by the current lookup when equal to visitedStamp
+            uint32_t fnv;
+            uint64_t deleted;
+        };
+
+        std::unordered_set<xstring> hashset1;  // delete candidates already queued, for longer prefixes
+        std::unordered_set<uint32_t> hashset2; // word ids already considered
+        std::vector<xstring> candidates;       // slots beyond candidateCount keep their capacity for reuse
+        size_t candidateCount = 0;
+        xstring candidate;
+        std::vector<MaskCandidate> maskCandidates;
+        std::vector<VisitedSlot> visited; // open addressing set of the queued mask candidates
+        uint32_t visitedStamp = 0;
+        size_t visitedCount = 0;
+        const xchar *prefix = nullptr;
+        int prefixLen = 0;
+        std::vector<SuggestId> suggestions;
+        EditDistance distanceComparer{DistanceAlgorithm::DamerauOSADistance};
+
+        // bucket entry that passed the checks of Lookup which do not depend on earlier suggestions
+        struct Survivor
+        {
+            uint32_t id;
+            int length;
+            const xchar *chars;
+            int distance; // Unverified until computed, -1 when larger than the bound it was computed with
+        };
+
+        static const int Unverified = -2;
+        static const size_t BatchSize = 32; // survivors verified together
+
+        std::vector<Survivor> survivors;
+        std::vector<size_t> verifyIndices;
+        std::vector<const xchar *> verifyTexts;
+        std::vector<int> verifyLengths;
+        std::vector<int> verifyDistances;
+        BatchDistance batchDistance;
+
+        void Reset(DistanceAlgorithm algorithm)
+        {
+            hashset1.clear();
+            hashset2.clear();
+            candidateCount = 0;
+            maskCandidates.clear();
+            visitedCount = 0;
+            if (++visitedStamp == 0)
+            {
+                std::fill(visited.begin(), visited.end(), VisitedSlot{0, 0, 0});
+                visitedStamp = 1;
+            }
+            suggestions.clear();
+            if (distanceComparer.Algorithm() != algorithm)
+                distanceComparer = EditDistance(algorithm);
+        }
+
+        // first candidate of a mask lookup: the whole prefix
+        void BeginMasks(const xchar *chars, int length)
+        {
+            prefix = chars;
+            prefixLen = length;
+            maskCandidates.push_back(MaskCandidate{0, DeleteEnumerator::Fnv(chars, length)});
+        }
+
+        // true when both masks leave the same characters of the prefix
+        bool SameDelete(uint64_t a, uint64_t b) const
+        {
+            if (a == b)
+                return true;
+            int i = 0, j = 0;
+            while (true)
+            {
+                while (i < prefixLen && (a >> i & 1))
+                    i++;
+                while (j < prefixLen && (b >> j & 1))
+                    j++;
+                if (i == prefixLen || j == prefixLen)
+                    return i == prefixLen && j == prefixLen;
+                if (prefix[i++] != prefix[j++])
+                    return false;
+            }
+        }
+
+        // true when no mask leaving the same characters was queued before
+        bool Visit(uint64_t deleted, uint32_t fnv)
+        {
+            if ((visitedCount + 1) * 2 > visited.size())
+            {
+                std::vector<VisitedSlot> old(std::max<size_t>(64, visited.size() * 2), VisitedSlot{0, 0, 0});
+                old.swap(visited);
+                for (const VisitedSlot &slot : old)
+                {
+                    if (slot.stamp != visitedStamp)
+                        continue;
+                    size_t i = slot.fnv & (visited.size() - 1);
+                    while (visited[i].stamp == visitedStamp)
+                        i = (i + 1) & (visited.size() - 1);
+                    visited[i] = slot;
+                }
+            }
+            size_t i = fnv & (visited.size() - 1);
+            while (visited[i].stamp == visitedStamp)
+            {
+                if (visited[i].fnv == fnv && SameDelete(visited[i].deleted, deleted))
+                    return false;
+                i = (i + 1) & (visited.size() - 1);
+            }
+            visited[i] = VisitedSlot{visitedStamp, fnv, deleted};
+            visitedCount++;
+            return true;
+        }
+
+        // queues the single char deletes of a mask candidate, in the order Lookup always produced them;
+        // the hash of the chars before the deleted one is carried over from the previous delete
+        void QueueDeletes(uint64_t parent)
+        {
+            uint32_t head = DeleteEnumerator::FnvOffset;
+            for (int p = 0; p < prefixLen; p++)
+            {
+                if (parent >> p & 1)
+                    continue;
+                uint32_t fnv = head;
+                for (int q = p + 1; q < prefixLen; q++)
+                    if (!(parent >> q & 1))
+                        fnv = DeleteEnumerator::FnvStep(fnv, prefix[q]);
+                uint64_t child = parent | (uint64_t(1) << p);
+                if (Visit(child, fnv))
+                    maskCandidates.push_back(MaskCandidate{child, fnv});
+                head = DeleteEnumerator::FnvStep(head, prefix[p]);
+            }
+        }
+
+        // free slot after the queued candidates; it is only queued by incrementing candidateCount
+        xstring &NextCandidate()
+        {
+            if (candidateCount == candidates.size())
+                candidates.emplace_back();
+            return candidates[candidateCount];
+        }
+    };
+
     class SymSpell
     {
     protected:
@@ -120,15 +305,24 @@ namespace symspellcpppy
         int compactMask;
         DistanceAlgorithm distanceAlgorithm = DistanceAlgorithm::DamerauOSADistance;
         int maxDictionaryWordLength; // maximum std::unordered_map term length
-        std::shared_ptr<std::unordered_map<int, std::vector<xstring>>> deletes;
-        std::unordered_map<xstring, int64_t> words;
-        std::unordered_map<xstring, int64_t> belowThresholdWords;
+        bool frozenIndex;            // CommitStaged builds the compact FrozenDeletes index instead of growing deletes
+        DeleteHasher deleteHasher;   // how a delete becomes the key of its bucket
+        std::shared_ptr<std::unordered_map<uint64_t, DeleteBucket>> deletes;
+        std::shared_ptr<FrozenDeletes> frozenDeletes;
+        WordTable words; // dictionary and below threshold words, interned once and shared by id with the delete buckets
+        LengthHistogram wordLengths; // dictionary words per length, maxDictionaryWordLength is its maximum
+        size_t frozenTombstones = 0; // words deleted since frozenDeletes was built, their ids are still in it
+        std::shared_ptr<IndexImage::MappedFile> mappedIndex; // image viewed by the arrays after LoadIndex
+        std::unique_ptr<LookupCache<std::vector<SuggestItem>>> lookupCache; // null unless enabled
+        IndexLock indexLock; // held shared by every lookup and exclusively by every change of the dictionary
 
     public:
         int MaxDictionaryEditDistance() const;
 
         int PrefixLength() const;
 
+        DeleteHasher Hasher() const;
+
         int MaxLength() const;
 
         long CountThreshold() const;
@@ -137,6 +331,9 @@ namespace symspellcpppy
 
         int EntryCount();
 
+        /// <summary>EntryCount() > 0, without walking the delete index.</summary>
+        bool HasEntries() const;
+
         /// <summary>Create a new instanc of SymSpell.</summary>
         /// <remarks>Specifying ann accurate initialCapacity is not essential,
         /// but it can help speed up processing by alleviating the need for
@@ -146,30 +343,93 @@ namespace symspellcpppy
         /// <param name="prefixLength">The length of word prefixes used for spell checking..</param>
         /// <param name="countThreshold">The minimum frequency count for dictionary words to be considered correct spellings.</param>
         /// <param name="compactLevel">Degree of favoring lower memory use over speed (0=fastest,most memory, 16=slowest,least memory).</param>
+        /// <param name="frozenIndex">Store deletes in a compact read-optimized index rebuilt by every CommitStaged
+        /// (much less memory and faster lookups, but each commit costs a full rebuild).</param>
+        /// <param name="deleteHasher">Hash of the delete buckets: Fnv32 is the original 32-bit key reduced by
+        /// compactLevel, so unrelated deletes share buckets; Fnv64 and WyHash are 64-bit keys that ignore
+        /// compactLevel and practically never collide.</param>
         explicit SymSpell(int maxDictionaryEditDistance = DEFAULT_MAX_EDIT_DISTANCE,
                           int prefixLength = DEFAULT_PREFIX_LENGTH, int countThreshold = DEFAULT_COUNT_THRESHOLD,
                           int initialCapacity = DEFAULT_INITIAL_CAPACITY,
-                          unsigned char compactLevel = DEFAULT_COMPACT_LEVEL);
+                          unsigned char compactLevel = DEFAULT_COMPACT_LEVEL,
+                          bool frozenIndex = false, DeleteHasher deleteHasher = Fnv32);
 
+        /// <summary>Create or update an entry in the dictionary.</summary>
+        /// <remarks>The deletes of a new word are added to staging, to be applied by CommitStaged; without staging
+        /// they are appended to the index right away, amortized O(1) per delete.</remarks>
+        /// <returns>True when key became a new dictionary word.</returns>
         bool CreateDictionaryEntry(const xstring &key, int64_t count, const std::shared_ptr<SuggestionStage> &staging);
 
+        /// <summary>Remove a word from the dictionary.</summary>
+        /// <remarks>The word is taken out of its delete buckets in place, empty buckets are dropped. A frozen or
+        /// mapped index keeps the id until it is compacted: lookups skip it, and once an eighth of the words
+        /// were deleted the index is compacted. The term itself stays interned in the word table (see
+        /// WordTable), so adding it again reuses its id.</remarks>
+        /// <returns>True when key was a dictionary word.</returns>
         bool DeleteDictionaryEntry(const xstring &key);
 
-        std::unordered_map<xstring, long> bigrams;
+        /// <summary>Remove many words from the dictionary, visiting every affected delete bucket once.</summary>
+        /// <returns>The number of keys that were dictionary words.</returns>
+        size_t DeleteDictionaryEntries(const std::vector<xstring> &keys);
+
+        /// <summary>Rebuild the frozen (or mapped) index without the ids of deleted words and the buckets
+        /// left empty.</summary>
+        /// <remarks>Adding a word whose id is still in the index compacts it first. The deleted terms stay
+        /// interned in the word table.</remarks>
+        void CompactIndex();
+
+        BigramTable bigrams; // counts keyed by the word ids of both words
         int64_t bigramCountMin = MAXLONG;
 
+        /// <summary>Count of the bigram "word1 word2" (0 when it is not in the bigram dictionary).</summary>
+        /// <remarks>Looks up the ids of both words and probes the pair, no "word1 word2" string is built.</remarks>
+        int64_t BigramCount(const xstring &word1, const xstring &word2) const;
+
+        /// <summary>Log10 probability of word following previous: the bigram count over the count of previous
+        /// when the bigram is known, else the smaller of the least bigram count over the count of previous and
+        /// the unigram probability of word (as LookupCompound scores splits). Without bigrams this is the
+        /// unigram probability.</summary>
+        double BigramLogProbability(const xstring &previous, int64_t previousCount, const xstring &word,
+                                    int64_t wordCount) const;
+
+        /// <summary>Save the word table, delete index and bigrams as a memory mappable index image.</summary>
+        /// <remarks>Any unfrozen deletes are merged into the frozen layout of the image.</remarks>
+        /// <param name="path">The path+filename of the image.</param>
+        /// <returns>True if the image was written.</returns>
+        bool SaveIndex(const std::string &path) const;
+
+        /// <summary>Replace the loaded dictionary with a memory mapped index image written by SaveIndex.</summary>
+        /// <remarks>Lookups read the mapped pages directly, nothing is deserialized; the edit distance,
+        /// prefix length, count threshold and compact level are taken from the image. Adding or deleting
+        /// entries afterwards copies the affected arrays into memory.</remarks>
+        /// <param name="path">The path+filename of the image.</param>
+        /// <returns>False if the file could not be opened or mapped.</returns>
+        /// <exception cref="std::invalid_argument">The file is not a valid index image of this version;
+        /// the loaded dictionary is left unchanged.</exception>
+        bool LoadIndex(const std::string &path);
+
         /// <summary>Load multiple dictionary entries from a file of word/frequency count pairs</summary>
         /// <remarks>Merges with any dictionary data already loaded.</remarks>
         /// <param name="corpus">The path+filename of the file.</param>
         /// <param name="termIndex">The column position of the word.</param>
         /// <param name="countIndex">The column position of the frequency count.</param>
         /// <param name="separatorChars">Separator characters between term(s) and count.</param>
+        /// <param name="onMalformed">Called for every line whose count is not a number or that lacks a column;
+        /// such lines are skipped.</param>
         /// <returns>True if file loaded, or false if file not found.</returns>
         bool LoadBigramDictionary(const std::string &corpus, int termIndex, int countIndex,
-                                  xchar separatorChars = DEFAULT_SEPARATOR_CHAR);
+                                  xchar separatorChars = DEFAULT_SEPARATOR_CHAR,
+                                  const MalformedLineHandler &onMalformed = nullptr);
 
         bool LoadBigramDictionary(xifstream &corpusStream, int termIndex, int countIndex,
-                                  xchar separatorChars = DEFAULT_SEPARATOR_CHAR);
+                                  xchar separatorChars = DEFAULT_SEPARATOR_CHAR,
+                                  const MalformedLineHandler &onMalformed = nullptr);
+
+        /// <summary>LoadBigramDictionary from the contents of a bigram file in memory.</summary>
+        /// <remarks>The text is parsed in place; it is not needed anymore once the call returns.</remarks>
+        bool LoadBigramDictionaryBuffer(const xchar *text, size_t size, int termIndex, int countIndex,
+                                        xchar separatorChars = DEFAULT_SEPARATOR_CHAR,
+                                        const MalformedLineHandler &onMalformed = nullptr);
 
         /// <summary>Load multiple dictionary entries from a file of word/frequency count pairs</summary>
         /// <remarks>Merges with any dictionary data already loaded.</remarks>
@@ -177,35 +437,77 @@ namespace symspellcpppy
         /// <param name="termIndex">The column position of the word.</param>
         /// <param name="countIndex">The column position of the frequency count.</param>
         /// <param name="separatorChars">Separator characters between term(s) and count.</param>
+        /// <param name="threads">Number of threads generating the deletes (0 = one per hardware thread);
+        /// the resulting dictionary is the same for any value.</param>
+        /// <param name="onMalformed">Called for every line whose count is not a number (the word is added with
+        /// count 1) or that lacks the term or count column (the line is skipped).</param>
         /// <returns>True if file loaded, or false if file not found.</returns>
         bool LoadDictionary(const std::string &corpus, int termIndex, int countIndex,
-                            xchar separatorChars = DEFAULT_SEPARATOR_CHAR);
+                            xchar separatorChars = DEFAULT_SEPARATOR_CHAR, int threads = 1,
+                            const MalformedLineHandler &onMalformed = nullptr);
 
         bool LoadDictionary(xifstream &corpusStream, int termIndex, int countIndex,
-                            xchar separatorChars = DEFAULT_SEPARATOR_CHAR);
+                            xchar separatorChars = DEFAULT_SEPARATOR_CHAR, int threads = 1,
+                            const MalformedLineHandler &onMalformed = nullptr);
+
+        /// <summary>LoadDictionary from the contents of a dictionary file in memory.</summary>
+        /// <remarks>The text is parsed in place, terms are copied straight into the dictionary; the buffer is not
+        /// needed anymore once the call returns.</remarks>
+        bool LoadDictionaryBuffer(const xchar *text, size_t size, int termIndex, int countIndex,
+                                  xchar separatorChars = DEFAULT_SEPARATOR_CHAR, int threads = 1,
+                                  const MalformedLineHandler &onMalformed = nullptr);
+
+        /// <summary>Create or update many dictionary entries at once.</summary>
+        /// <remarks>Counts are merged as by CreateDictionaryEntry, then the deletes of all new words are staged
+        /// and committed in a single pass.</remarks>
+        /// <param name="entries">Terms with their counts.</param>
+        /// <param name="threads">Number of threads generating the deletes (0 = one per hardware thread);
+        /// the resulting dictionary is the same for any value.</param>
+        /// <returns>The number of entries that became new dictionary words.</returns>
+        size_t CreateDictionaryEntries(const std::vector<std::pair<xstring, int64_t>> &entries, int threads = 1);
 
         /// <summary>Load multiple dictionary words from a file containing plain text.</summary>
         /// <remarks>Merges with any dictionary data already loaded.</remarks>
         /// <param name="corpus">The path+filename of the file.</param>
+        /// <param name="threads">Number of threads generating the deletes (0 = one per hardware thread);
+        /// the resulting dictionary is the same for any value.</param>
         /// <returns>True if file loaded, or false if file not found.</returns>
-        bool CreateDictionary(const std::string &corpus);
+        bool CreateDictionary(const std::string &corpus, int threads = 1);
 
-        bool CreateDictionary(xifstream &corpusStream);
+        bool CreateDictionary(xifstream &corpusStream, int threads = 1);
 
         /// <summary>Remove all below threshold words from the dictionary.</summary>
-        /// <remarks>This can be used to reduce memory consumption after populating the dictionary from
-        /// a corpus using CreateDictionary.</remarks>
+        /// <remarks>This can be used after populating the dictionary from a corpus using CreateDictionary.
+        /// The purged terms stay interned in the word table, only their counts are dropped.</remarks>
         void PurgeBelowThresholdWords();
 
         void CommitStaged(const std::shared_ptr<SuggestionStage> &staging);
 
+        /// <summary>Commit several staging areas at once.</summary>
+        /// <remarks>The stages are appended in the given order; with more than one thread the buckets are
+        /// filled in parallel, each bucket by a single worker, so the result does not depend on threads.</remarks>
+        void CommitStages(const std::vector<SuggestionStage *> &stages, int threads);
+
+        /// <summary>Cache the results of Lookup calls made without a LookupContext.</summary>
+        /// <remarks>LookupCompound and WordSegmentation look up the same fragments over and over, within and
+        /// across inputs. The cache is bounded (least recently used entries are evicted), safe to share between
+        /// threads, and invalidated by every change to the dictionary.</remarks>
+        /// <param name="capacity">Maximum number of cached results (0 = disable the cache).</param>
+        void EnableLookupCache(size_t capacity);
+
+        /// <summary>Drop all cached lookup results and reset the hit/miss counters.</summary>
+        void ClearLookupCache();
+
+        /// <summary>Hits, misses, size and capacity of the lookup cache (all 0 when it is disabled).</summary>
+        LookupCache<std::vector<SuggestItem>>::Stats LookupCacheStats() const;
+
         /// <summary>Find suggested spellings for a given input word, using the maximum
         /// edit distance specified during construction of the SymSpell dictionary.</summary>
         /// <param name="input">The word being spell checked.</param>
         /// <param name="verbosity">The value controlling the quantity/closeness of the retuned suggestions.</param>
         /// <returns>A List of SuggestItem object representing suggested correct spellings for the input word,
         /// sorted by edit distance, and secondarily by count frequency.</returns>
-        std::vector<SuggestItem> Lookup(const xstring &input, Verbosity verbosity);
+        std::vector<SuggestItem> Lookup(const xstring &input, Verbosity verbosity) const;
 
         /// <summary>Find suggested spellings for a given input word, using the maximum
         /// edit distance specified during construction of the SymSpell dictionary.</summary>
@@ -214,7 +516,7 @@ namespace symspellcpppy
         /// <param name="maxEditDistance">The maximum edit distance between input and suggested words.</param>
         /// <returns>A List of SuggestItem object representing suggested correct spellings for the input word,
         /// sorted by edit distance, and secondarily by count frequency.</returns>
-        std::vector<SuggestItem> Lookup(const xstring &input, Verbosity verbosity, int maxEditDistance);
+        std::vector<SuggestItem> Lookup(const xstring &input, Verbosity verbosity, int maxEditDistance) const;
 
         /// <summary>Find suggested spellings for a given input word.</summary>
         /// <param name="input">The word being spell checked.</param>
@@ -223,7 +525,7 @@ namespace symspellcpppy
         /// <param name="includeUnknown">Include input word in suggestions, if no words within edit distance found.</param>
         /// <returns>A List of SuggestItem object representing suggested correct spellings for the input word,
         /// sorted by edit distance, and secondarily by count frequency.</returns>
-        std::vector<SuggestItem> Lookup(const xstring &input, Verbosity verbosity, int maxEditDistance, bool includeUnknown);
+        std::vector<SuggestItem> Lookup(const xstring &input, Verbosity verbosity, int maxEditDistance, bool includeUnknown) const;
 
         /// <summary>Find suggested spellings for a given input word.</summary>
         /// <param name="input">The word being spell checked.</param>
@@ -233,20 +535,69 @@ namespace symspellcpppy
         /// <param name="transfer_casing"> Lower case the word or not
         /// <returns>A List of SuggestItem object representing suggested correct spellings for the input word,
         /// sorted by edit distance, and secondarily by count frequency.</returns>
-        std::vector<SuggestItem> Lookup(const xstring &input, Verbosity verbosity, int maxEditDistance, bool includeUnknown, bool transferCasing);
+        std::vector<SuggestItem> Lookup(const xstring &input, Verbosity verbosity, int maxEditDistance, bool includeUnknown, bool transferCasing) const;
+
+        /// <summary>Find suggested spellings for a given input word, using caller owned scratch state.</summary>
+        /// <remarks>Lookup never modifies the dictionary: any number of threads may look up concurrently,
+        /// each with its own context. Concurrent lookups share no mutex or counter: a lookup only marks a
+        /// counter of its own thread and checks that no change is running. Adding or deleting entries from
+        /// another thread waits for the running lookups and holds back new ones until it is done.</remarks>
+        /// <param name="input">The word being spell checked.</param>
+        /// <param name="verbosity">The value controlling the quantity/closeness of the retuned suggestions.</param>
+        /// <param name="maxEditDistance">The maximum edit distance between input and suggested words.</param>
+        /// <param name="includeUnknown">Include input word in suggestions, if no words within edit distance found.</param>
+        /// <param name="transferCasing">Lower case the word and transfer its casing to the suggestions.</param>
+        /// <param name="context">Scratch buffers reused across calls.</param>
+        /// <returns>A List of SuggestItem object representing suggested correct spellings for the input word,
+        /// sorted by edit distance, and secondarily by count frequency.</returns>
+        std::vector<SuggestItem> Lookup(const xstring &input, Verbosity verbosity, int maxEditDistance, bool includeUnknown,
+                                        bool transferCasing, LookupContext &context) const;
+
+        /// <summary>Find suggested spellings for many input words, spread over worker threads.</summary>
+        /// <remarks>The batch holds the dictionary lock shared for its whole run, so changes of the dictionary
+        /// made meanwhile from other threads wait until it is done.</remarks>
+        /// <param name="inputs">The words being spell checked.</param>
+        /// <param name="threads">Number of worker threads (0 = one per hardware thread).</param>
+        /// <returns>The Lookup result of every input word, in input order.</returns>
+        std::vector<std::vector<SuggestItem>> LookupBatch(const std::vector<xstring> &inputs, Verbosity verbosity, int maxEditDistance,
+                                                          bool includeUnknown, bool transferCasing, int threads = 0) const;
 
     private:
+        // Updates the counts of key; true when key just became a dictionary word whose deletes are still missing.
+        bool CountEntry(const xchar *key, size_t len, int64_t count, uint32_t &id);
+
+        // true when the frozen index lists id, which for a word that is not in the dictionary is a tombstone
+        bool InFrozenIndex(uint32_t id) const;
+
+        // The file loaders memory map the file (or read a stream at once) and parse it as a buffer.
+
+        static xstring ReadAll(xifstream &stream);
+
+        void StageDeletes(uint32_t id, SuggestionStage &staging) const;
+
+        // Appends the deletes of a new word to their buckets in place, amortized O(1) each. With a frozen index
+        // the buckets are the overlay that lookups read after the frozen spans and the next commit merges.
+        void AppendDeletes(uint32_t id);
+
+        // Stages and commits the deletes of newly added words, spread over threads in contiguous chunks.
+        void BuildDeletes(const std::vector<uint32_t> &newWords, int threads);
+
         bool
-        DeleteInSuggestionPrefix(const xstring &deleteSugg, int deleteLen, xstring suggestion, int suggestionLen) const;
+        DeleteInSuggestionPrefix(const xstring &deleteSugg, int deleteLen, const xchar *suggestion, int suggestionLen) const;
 
         static std::vector<xstring> ParseWords(const xstring &text);
 
-        std::shared_ptr<std::unordered_set<xstring>>
-        Edits(const xstring &word, int editDistance, std::shared_ptr<std::unordered_set<xstring>> deleteWords);
+        // delete hash from the FNV-1a hash of a delete of length len
+        uint64_t DeleteHash(const xchar *chars, int len, uint32_t fnv) const;
 
-        std::shared_ptr<std::unordered_set<xstring>> EditsPrefix(const xstring &key);
+        // cached lookup results depend on the dictionary, so every change to it goes through here
+        void InvalidateLookupCache();
 
-        int GetstringHash(const xstring &s) const;
+        // rebuilds wordLengths after the word table was replaced
+        void CountWordLengths();
+
+        // true and the count when "word1 word2" is in the bigram dictionary (a known bigram may count 0)
+        bool FindBigram(const xstring &word1, const xstring &word2, int64_t &count) const;
 
     public:
         // ######################
@@ -259,19 +610,26 @@ namespace symspellcpppy
         /// <summary>Find suggested spellings for a multi-word input string (supports word splitting/merging).</summary>
         /// <param name="input">The string being spell checked.</param>
         /// <returns>A List of SuggestItem object representing suggested correct spellings for the input string.</returns>
-        std::vector<SuggestItem> LookupCompound(const xstring &input);
+        std::vector<SuggestItem> LookupCompound(const xstring &input) const;
 
         /// <summary>Find suggested spellings for a multi-word input string (supports word splitting/merging).</summary>
         /// <param name="input">The string being spell checked.</param>
         /// <param name="maxEditDistance">The maximum edit distance between input and suggested words.</param>
         /// <returns>A List of SuggestItem object representing suggested correct spellings for the input string.</returns>
-        std::vector<SuggestItem> LookupCompound(const xstring &input, int editDistanceMax);
+        std::vector<SuggestItem> LookupCompound(const xstring &input, int editDistanceMax) const;
 
         /// <summary>Find suggested spellings for a multi-word input string (supports word splitting/merging).</summary>
         /// <param name="input">The string being spell checked.</param>
         /// <param name="maxEditDistance">The maximum edit distance between input and suggested words.</param>
         /// <returns>A List of SuggestItem object representing suggested correct spellings for the input string.</returns>
-        std::vector<SuggestItem> LookupCompound(const xstring &input, int editDistanceMax, bool transferCasing);
+        std::vector<SuggestItem> LookupCompound(const xstring &input, int editDistanceMax, bool transferCasing) const;
+
+        /// <summary>Find suggested spellings for many multi-word input strings, spread over worker threads.</summary>
+        /// <param name="inputs">The strings being spell checked.</param>
+        /// <param name="threads">Number of worker threads (0 = one per hardware thread).</param>
+        /// <returns>The LookupCompound result of every input string, in input order.</returns>
+        std::vector<std::vector<SuggestItem>> LookupCompoundBatch(const std::vector<xstring> &inputs, int editDistanceMax,
+                                                                  bool transferCasing, int threads = 0) const;
 
         // ######
 
@@ -295,7 +653,7 @@ namespace symspellcpppy
         /// the word segmented and spelling corrected string,
         /// the Edit distance sum between input string and corrected string,
         /// the Sum of word occurrence probabilities in log scale (a measure of how common and probable the corrected segmentation is).</returns>
-        Info WordSegmentation(const xstring &input);
+        Info WordSegmentation(const xstring &input) const;
 
         /// <summary>Find suggested spellings for a multi-word input string (supports word splitting/merging).</summary>
         /// <param name="input">The string being spell checked.</param>
@@ -305,7 +663,7 @@ namespace symspellcpppy
         /// the word segmented and spelling corrected string,
         /// the Edit distance sum between input string and corrected string,
         /// the Sum of word occurrence probabilities in log scale (a measure of how common and probable the corrected segmentation is).</returns>
-        Info WordSegmentation(const xstring &input, int maxEditDistance);
+        Info WordSegmentation(const xstring &input, int maxEditDistance) const;
 
         /// <summary>Find suggested spellings for a multi-word input string (supports word splitting/merging).</summary>
         /// <param name="input">The string being spell checked.</param>
@@ -316,12 +674,163 @@ namespace symspellcpppy
         /// the word segmented and spelling corrected string,
         /// the Edit distance sum between input string and corrected string,
         /// the Sum of word occurrence probabilities in log scale (a measure of how common and probable the corrected segmentation is).</returns>
-        Info WordSegmentation(const xstring &input, int maxEditDistance, int maxSegmentationWordLength);
+        Info WordSegmentation(const xstring &input, int maxEditDistance, int maxSegmentationWordLength) const;
+
+        /// <summary>The topK best segmentations of a multi-word input string, for reranking.</summary>
+        /// <remarks>Every part of the input is looked up once whatever topK is; only the compositions kept per
+        /// position grow with it.</remarks>
+        /// <param name="input">The string being spell checked.</param>
+        /// <param name="topK">The maximum number of segmentations returned.</param>
+        /// <param name="maxEditDistance">The maximum edit distance between input and corrected words
+        /// (0=no correction/segmentation only).</param>
+        /// <param name="maxSegmentationWordLength">The maximum word length that should be considered.</param>
+        /// <returns>Up to topK results as WordSegmentation returns them. The first is the result of
+        /// WordSegmentation, the others are ordered by edit distance without the inserted spaces, then by
+        /// probability.</returns>
+        std::vector<Info> WordSegmentationTopK(const xstring &input, int topK, int maxEditDistance,
+                                               int maxSegmentationWordLength) const;
+
+        /// <summary>WordSegmentation scoring every word by its bigram probability given the previous word.</summary>
+        /// <remarks>Uses the bigrams of LoadBigramDictionary in the DP transition: the best composition is kept
+        /// for every position and last word (Viterbi over the last word), compositions are compared by edit
+        /// distance without the inserted spaces, then by probability.</remarks>
+        /// <param name="input">The string being spell checked.</param>
+        /// <param name="maxEditDistance">The maximum edit distance between input and corrected words
+        /// (0=no correction/segmentation only).</param>
+        /// <param name="maxSegmentationWordLength">The maximum word length that should be considered.</param>
+        /// <returns>The segmentation, as WordSegmentation returns it.</returns>
+        Info WordSegmentationBigrams(const xstring &input, int maxEditDistance, int maxSegmentationWordLength) const;
+
+        /// <summary>Segment many input strings, spread over worker threads.</summary>
+        /// <param name="inputs">The strings being segmented.</param>
+        /// <param name="threads">Number of worker threads (0 = one per hardware thread).</param>
+        /// <returns>The WordSegmentation result of every input string, in input order.</returns>
+        std::vector<Info> WordSegmentationBatch(const std::vector<xstring> &inputs, int maxEditDistance,
+                                                int maxSegmentationWordLength, int threads = 0) const;
 
         template <class Archive>
-        void serialize(Archive &ar)
+        void save(Archive &ar) const
+        {
+            IndexLock::Guard guard(indexLock, IndexLock::Shared);
+            ar(deletes, words, maxDictionaryWordLength, frozenDeletes, frozenIndex, deleteHasher,
+               static_cast<uint64_t>(frozenTombstones), bigrams, bigramCountMin);
+        }
+
+        template <class Archive>
+        void load(Archive &ar)
+        {
+            IndexLock::Guard guard(indexLock, IndexLock::Exclusive);
+            InvalidateLookupCache();
+            uint64_t tombstones;
+            // bigrams are keyed by word ids, so they are only valid together with the word table they came with
+            ar(deletes, words, maxDictionaryWordLength, frozenDeletes, frozenIndex, deleteHasher, tombstones, bigrams,
+               bigramCountMin);
+            frozenTombstones = static_cast<size_t>(tombstones);
+            CountWordLengths();
+        }
+    };
+
+    /// <summary>WordSegmentation over text that arrives in chunks.</summary>
+    /// <remarks>Push feeds the next chunk and returns the words that no later input can change anymore, Finish
+    /// ends the text and returns the rest. Joined together, the returned pieces are exactly the segmented and
+    /// corrected strings WordSegmentation returns for the whole text. Only the text after the last committed word
+    /// is kept, which in practice is a few words: every composition that can still be extended ends in the last
+    /// maxSegmentationWordLength chars, and once they all share a prefix of words that prefix is final.
+    /// With a beam width above 1, the beamWidth best compositions are kept for every position (the first is the
+    /// one WordSegmentation keeps) and FinishTopK returns all of them.
+    /// The SymSpell instance must outlive the stream; changing its dictionary between two chunks changes the
+    /// words that are still open. Calls on one stream from several threads are serialized.</remarks>
+    class WordSegmentationStream
+    {
+    public:
+        /// <summary>Create a stream segmenting with the given options (see SymSpell::WordSegmentation).</summary>
+        /// <param name="beamWidth">Number of compositions kept for every position.</param>
+        /// <param name="bigramScoring">Score words by the bigram probability given the previous word (Viterbi over
+        /// the last word) instead of by their own probability; cannot be combined with a beam.</param>
+        WordSegmentationStream(const SymSpell &symSpell, int maxEditDistance, int maxSegmentationWordLength,
+                               int beamWidth = 1, bool bigramScoring = false);
+
+        /// <summary>Append the next chunk of text.</summary>
+        /// <returns>The newly committed words, to be appended to the previous pieces, with the edit distance and
+        /// log probability they add.</returns>
+        Info Push(const xstring &chunk);
+
+        /// <summary>End the text; the next Push starts a new one.</summary>
+        /// <returns>The remaining words, as Push does.</returns>
+        Info Finish();
+
+        /// <summary>End the text, keeping every composition of the beam; the next Push starts a new one.</summary>
+        /// <returns>For each of the beamWidth best compositions of the text (fewer for short texts, and the
+        /// compositions spelling the same words as a better one are left out), the words
+        /// after the committed ones, with the edit distance and log probability sums of the whole text. The first
+        /// is the one Finish returns, the others are ordered by edit distance without the inserted spaces, then by
+        /// probability.</returns>
+        std::vector<Info> FinishTopK();
+
+        /// <summary>Edit distance sum of the words committed so far (of the whole text after Finish).</summary>
+        int Distance() const
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return distance;
+        }
+
+        /// <summary>Log probability sum of the words committed so far (of the whole text after Finish).</summary>
+        double Probability() const
         {
-            ar(deletes, words, maxDictionaryWordLength);
+            std::lock_guard<std::mutex> lock(mutex);
+            return probability;
         }
+
+    private:
+        // composition ending at some position: its scores and how its last word was chosen
+        struct Composition
+        {
+            bool filled = false;
+            int distance = 0;
+            int separators = 0; // spaces inserted before words, counted in distance
+            double probability = 0;
+            int previous = 0;               // end of the composition this one extends (0 = none)
+            int previousRank = 0;           // and its place in the beam of that position
+            int partBegin = 0, partEnd = 0; // last word as written: range of compact
+            bool joined = false;            // last word attached to the previous one without a space
+            xstring corrected;              // last word as corrected
+            xstring term;                   // and as in the dictionary, with bigram scoring (empty when unknown)
+            int64_t count = 0;
+        };
+
+        const SymSpell &symSpell;
+        int maxEditDistance;
+        int maxSegmentationWordLength;
+        int beamWidth;
+        bool bigramScoring;
+        int slots; // compositions kept per position: the beam, or one per last word length with bigram scoring
+        bool finished = false;
+        mutable std::mutex mutex; // held by the public methods, which all change or read the buffers below
+
+        // Positions are offsets in the whole text; the buffers below start at base (compactBase for the
+        // compact ones) and are trimmed as words are committed. Compositions are stored slots per position.
+        int base = 0;
+        int compactBase = 0;
+        xstring text;                  // input chars
+        std::vector<int> compactIndex; // offset of every input position in the input without spaces
+        xstring compact;               // input without spaces
+        xstring compactLower;          // and lowercase
+        std::vector<Composition> steps; // final compositions ending at every position up to processed
+
+        std::deque<Composition> compositions; // compositions still being improved, ending at processed + 1...
+        int processed = 0;     // start positions whose parts have all been scored
+        int committed = 0;     // end of the committed words
+        int committedRank = 0; // and the place of their composition in the beam
+        int distance = 0;
+        double probability = 0;
+        xstring partLower;
+
+        void Reset();
+        void Score(int imax);
+        int BestRank(int position) const;
+        void Keep(int beam, Composition &&candidate);
+        void Words(int end, int rank, xstring &segmented, xstring &corrected) const;
+        Info Commit(int end, int rank);
+        void Trim();
     };
-}
+}
\ No newline at end of file
@@ -148,6 +148,1087 @@ TEST_CASE("Testing English", "[english]")
         REQUIRE(XL("take") == results[0].term);
     }
 
+    SECTION("Frozen index matches default index")
+    {
+        SymSpell symSpell(maxEditDistance, prefixLength);
+        symSpell.LoadDictionary("../resources/frequency_dictionary_en_82_765.txt", 0, 1, XL(' '));
+        SymSpell symSpellFrozen(maxEditDistance, prefixLength, DEFAULT_COUNT_THRESHOLD, DEFAULT_INITIAL_CAPACITY,
+                                DEFAULT_COMPACT_LEVEL, true);
+        symSpellFrozen.LoadDictionary("../resources/frequency_dictionary_en_82_765.txt", 0, 1, XL(' '));
+        REQUIRE(symSpell.EntryCount() == symSpellFrozen.EntryCount());
+        REQUIRE(symSpell.WordCount() == symSpellFrozen.WordCount());
+
+        for (const xchar *word : {XL("tke"), XL("abolution"), XL("intermedaite"), XL("extrine"), XL("elipnaht")})
+        {
+            for (auto verbosity : {Verbosity::Top, Verbosity::Closest, Verbosity::All})
+            {
+                auto expected = symSpell.Lookup(word, verbosity, 2);
+                auto results = symSpellFrozen.Lookup(word, verbosity, 2);
+                REQUIRE(expected.size() == results.size());
+                for (size_t i = 0; i < expected.size(); i++)
+                    REQUIRE(expected[i].Equals(results[i]));
+            }
+        }
+
+        auto staging = std::make_shared<SuggestionStage>(100);
+        symSpellFrozen.CreateDictionaryEntry(XL("tkae"), 1000000000000, staging);
+        symSpellFrozen.CommitStaged(staging);
+        REQUIRE(XL("tkae") == symSpellFrozen.Lookup(XL("tke"), Verbosity::Top, 1)[0].term);
+    }
+
+    SECTION("Deleted and below threshold words are not suggested")
+    {
+        SymSpell symSpellcustom(maxEditDistance, prefixLength, 10);
+        auto staging = std::make_shared<SuggestionStage>(100);
+        symSpellcustom.CreateDictionaryEntry(XL("steam"), 20, staging);
+        symSpellcustom.CreateDictionaryEntry(XL("steama"), 30, staging);
+        symSpellcustom.CreateDictionaryEntry(XL("steams"), 5, staging);
+        symSpellcustom.CommitStaged(staging);
+        REQUIRE(2 == symSpellcustom.WordCount());
+        REQUIRE(XL("steama") == symSpellcustom.Lookup(XL("steamx"), Verbosity::Top, 1)[0].term);
+
+        REQUIRE(symSpellcustom.DeleteDictionaryEntry(XL("steama")));
+        REQUIRE(1 == symSpellcustom.WordCount());
+        auto results = symSpellcustom.Lookup(XL("steamx"), Verbosity::All, 1);
+        REQUIRE(1 == results.size());
+        REQUIRE(XL("steam") == results[0].term);
+        REQUIRE(1 == symSpellcustom.WordCount());
+    }
+
+    SECTION("Mapped index image matches loaded dictionary")
+    {
+        SymSpell symSpell(maxEditDistance, prefixLength);
+        symSpell.LoadDictionary("../resources/frequency_dictionary_en_82_765.txt", 0, 1, XL(' '));
+        auto filepath = "../resources/index.bin";
+        REQUIRE(symSpell.SaveIndex(filepath));
+
+        SymSpell symSpellMapped(1, 3);
+        REQUIRE(symSpellMapped.LoadIndex(filepath));
+        REQUIRE(symSpell.MaxDictionaryEditDistance() == symSpellMapped.MaxDictionaryEditDistance());
+        REQUIRE(symSpell.PrefixLength() == symSpellMapped.PrefixLength());
+        REQUIRE(symSpell.MaxLength() == symSpellMapped.MaxLength());
+        REQUIRE(symSpell.WordCount() == symSpellMapped.WordCount());
+        REQUIRE(symSpell.EntryCount() == symSpellMapped.EntryCount());
+        for (const xchar *word : {XL("tke"), XL("abolution"), XL("intermedaite"), XL("extrine"), XL("elipnaht")})
+        {
+            auto expected = symSpell.Lookup(word, Verbosity::All, 2);
+            auto results = symSpellMapped.Lookup(word, Verbosity::All, 2);
+            REQUIRE(expected.size() == results.size());
+            for (size_t i = 0; i < expected.size(); i++)
+                REQUIRE(expected[i].Equals(results[i]));
+        }
+        REQUIRE(symSpell.LookupCompound(XL("whereis th elove"))[0].term ==
+                symSpellMapped.LookupCompound(XL("whereis th elove"))[0].term);
+
+        auto staging = std::make_shared<SuggestionStage>(100);
+        symSpellMapped.CreateDictionaryEntry(XL("tkae"), 1000000000000, staging);
+        symSpellMapped.CommitStaged(staging);
+        REQUIRE(XL("tkae") == symSpellMapped.Lookup(XL("tke"), Verbosity::Top, 1)[0].term);
+        REQUIRE(XL("the") == symSpell.Lookup(XL("tke"), Verbosity::Top, 1)[0].term);
+        std::remove(filepath);
+    }
+
+    SECTION("Index images with delete ids or slots out of range are rejected")
+    {
+        // one bucket of two ids in a table of two slots
+        auto map = [](uint32_t lastId, uint32_t bucket, uint32_t wordCount)
+        {
+            {
+                IndexImage::Writer image("bad.idx");
+                image.Array(FlatArray<FrozenDeletes::Slot>{FrozenDeletes::Slot{7, bucket, LengthRange()},
+                                                          FrozenDeletes::Slot{0, FrozenDeletes::EmptySlot, LengthRange()}});
+                image.Array(FlatArray<uint64_t>{7});
+                image.Array(FlatArray<uint32_t>{0, 2});
+                image.Array(FlatArray<uint32_t>{0, lastId});
+                image.Array(FlatArray<uint8_t>{3, 3});
+                image.Scalar(1);
+                image.Scalar(31);
+            }
+            IndexImage::MappedFile file("bad.idx");
+            IndexImage::Reader image(file.Data(), file.Size());
+            FrozenDeletes deletes;
+            deletes.Map(image, wordCount);
+            return deletes.IdCount();
+        };
+        REQUIRE(map(1, 0, 2) == 2);
+        REQUIRE_THROWS_AS(map(2, 0, 2), std::invalid_argument);
+        REQUIRE_THROWS_AS(map(1, 1, 2), std::invalid_argument);
+
+        // one bigram in a table of slotCount slots
+        auto mapBigrams = [](FlatArray<uint32_t> slots, uint32_t slotMask)
+        {
+            {
+                IndexImage::Writer image("bad.idx");
+                image.Array(FlatArray<uint64_t>{(uint64_t)1 << 32 | 2});
+                image.Array(FlatArray<int64_t>{5});
+                image.Array(slots);
+                image.Scalar(slotMask);
+            }
+            IndexImage::MappedFile file("bad.idx");
+            IndexImage::Reader image(file.Data(), file.Size());
+            BigramTable bigrams;
+            bigrams.Map(image);
+            return bigrams.Size();
+        };
+        REQUIRE(mapBigrams(FlatArray<uint32_t>{0, 1}, 1) == 1);
+        REQUIRE_THROWS_AS(mapBigrams(FlatArray<uint32_t>{0, 1, 0}, 2), std::invalid_argument);
+        REQUIRE_THROWS_AS(mapBigrams(FlatArray<uint32_t>{0, 2}, 1), std::invalid_argument);
+        REQUIRE_THROWS_AS(mapBigrams(FlatArray<uint32_t>{1}, 0), std::invalid_argument);
+
+        SymSpell symSpell(maxEditDistance, prefixLength);
+        symSpell.CreateDictionaryEntry(XL("steam"), 4, nullptr);
+
+        // header scalars follow the 16 bytes of magic, version and byte order; 4 is the distance
+        // algorithm, 7 the delete hasher
+        for (int scalar : {4, 7})
+        {
+            REQUIRE(symSpell.SaveIndex("bad.idx"));
+            {
+                std::fstream image("bad.idx", std::ios::binary | std::ios::in | std::ios::out);
+                int64_t value = 9;
+                image.seekp(16 + scalar * 8);
+                image.write(reinterpret_cast<const char *>(&value), sizeof(value));
+            }
+            SymSpell loaded(maxEditDistance, prefixLength);
+            REQUIRE_THROWS_AS(loaded.LoadIndex("bad.idx"), std::invalid_argument);
+        }
+        {
+            std::ofstream truncated("bad.idx", std::ios::binary | std::ios::trunc);
+            truncated.write("SYMSPIDX", 8);
+        }
+        REQUIRE_THROWS_AS(symSpell.LoadIndex("bad.idx"), std::invalid_argument);
+        REQUIRE(symSpell.Lookup(XL("stream"), Verbosity::Top, 1)[0].term == XL("steam"));
+        std::remove("bad.idx");
+        REQUIRE_FALSE(symSpell.LoadIndex("bad.idx"));
+    }
+
+    SECTION("Batch lookups match single lookups")
+    {
+        SymSpell symSpell(maxEditDistance, prefixLength);
+        symSpell.LoadDictionary("../resources/frequency_dictionary_en_82_765.txt", 0, 1, XL(' '));
+        std::vector<xstring> words{XL("tke"), XL("abolution"), XL("intermedaite"), XL("extrine"), XL("elipnaht"),
+                                   XL("Tke"), XL("qxqxqx")};
+        auto results = symSpell.LookupBatch(words, Verbosity::Closest, 2, true, true, 4);
+        REQUIRE(words.size() == results.size());
+        for (size_t i = 0; i < words.size(); i++)
+        {
+            auto expected = symSpell.Lookup(words[i], Verbosity::Closest, 2, true, true);
+            REQUIRE(expected.size() == results[i].size());
+            for (size_t j = 0; j < expected.size(); j++)
+                REQUIRE(expected[j].Equals(results[i][j]));
+        }
+
+        std::vector<xstring> sentences{XL("whereis th elove"), XL("can yu readthis"), XL("thequickbrownfoxjumpsoverthelazydog")};
+        auto compound = symSpell.LookupCompoundBatch(sentences, 2, false, 2);
+        auto segmented = symSpell.WordSegmentationBatch(sentences, 2, symSpell.MaxLength(), 2);
+        for (size_t i = 0; i < sentences.size(); i++)
+        {
+            REQUIRE(symSpell.LookupCompound(sentences[i], 2)[0].term == compound[i][0].term);
+            REQUIRE(symSpell.WordSegmentation(sentences[i], 2).getCorrected() == segmented[i].getCorrected());
+        }
+    }
+
+    SECTION("Lookup context can be reused across lookups and threads")
+    {
+        SymSpell symSpell(maxEditDistance, prefixLength);
+        symSpell.LoadDictionary("../resources/frequency_dictionary_en_82_765.txt", 0, 1, XL(' '));
+        const SymSpell &dictionary = symSpell;
+        std::vector<xstring> words{XL("tke"), XL("abolution"), XL("intermedaite"), XL("extrine"), XL("elipnaht"),
+                                   XL("a"), XL("Tke")};
+
+        LookupContext context;
+        for (const xstring &word : words)
+        {
+            for (auto verbosity : {Verbosity::Top, Verbosity::Closest, Verbosity::All})
+            {
+                auto expected = dictionary.Lookup(word, verbosity, 2, true, true);
+                auto results = dictionary.Lookup(word, verbosity, 2, true, true, context);
+                REQUIRE(expected.size() == results.size());
+                for (size_t i = 0; i < expected.size(); i++)
+                    REQUIRE(expected[i].Equals(results[i]));
+            }
+        }
+
+        std::vector<std::vector<SuggestItem>> results(4);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++)
+            threads.emplace_back([&, t]()
+                                 {
+                                     LookupContext threadContext;
+                                     for (int round = 0; round < 50; round++)
+                                         results[t] = dictionary.Lookup(words[t], Verbosity::Closest, 2, false, false, threadContext); });
+        for (auto &thread : threads)
+            thread.join();
+        for (int t = 0; t < 4; t++)
+        {
+            auto expected = dictionary.Lookup(words[t], Verbosity::Closest, 2);
+            REQUIRE(expected.size() == results[t].size());
+            for (size_t i = 0; i < expected.size(); i++)
+                REQUIRE(expected[i].Equals(results[t][i]));
+        }
+    }
+
+    SECTION("Parallel loops visit every index once, nest and rethrow")
+    {
+        for (int round = 0; round < 20; round++)
+        {
+            std::vector<std::atomic<int>> seen(64);
+            for (auto &count : seen)
+                count = 0;
+            // the inner loops run while the pooled helpers are busy with the outer one
+            Parallel::For(seen.size(), 4, [&](size_t i)
+                          { Parallel::For(4, 4, [&](size_t)
+                                          { seen[i]++; }); });
+            for (auto &count : seen)
+                REQUIRE(count == 4);
+        }
+        REQUIRE_THROWS_AS(Parallel::For(100, 4, [](size_t i)
+                                        { if (i == 50) throw std::invalid_argument("item"); }),
+                          std::invalid_argument);
+    }
+
+    SECTION("Parallel dictionary build matches serial build")
+    {
+        for (bool frozen : {false, true})
+        {
+            SymSpell symSpell(maxEditDistance, prefixLength, DEFAULT_COUNT_THRESHOLD, DEFAULT_INITIAL_CAPACITY,
+                              DEFAULT_COMPACT_LEVEL, frozen);
+            symSpell.LoadDictionary("../resources/frequency_dictionary_en_82_765.txt", 0, 1, XL(' '));
+            SymSpell symSpellParallel(maxEditDistance, prefixLength, DEFAULT_COUNT_THRESHOLD, DEFAULT_INITIAL_CAPACITY,
+                                      DEFAULT_COMPACT_LEVEL, frozen);
+            symSpellParallel.LoadDictionary("../resources/frequency_dictionary_en_82_765.txt", 0, 1, XL(' '), 4);
+            REQUIRE(symSpell.EntryCount() == symSpellParallel.EntryCount());
+            REQUIRE(symSpell.WordCount() == symSpellParallel.WordCount());
+
+            for (const xchar *word : {XL("tke"), XL("abolution"), XL("intermedaite"), XL("extrine"), XL("stream")})
+            {
+                for (auto verbosity : {Verbosity::Top, Verbosity::Closest, Verbosity::All})
+                {
+                    auto expected = symSpell.Lookup(word, verbosity, 2);
+                    auto results = symSpellParallel.Lookup(word, verbosity, 2);
+                    REQUIRE(expected.size() == results.size());
+                    for (size_t i = 0; i < expected.size(); i++)
+                        REQUIRE(expected[i].Equals(results[i]));
+                }
+            }
+        }
+    }
+
+    SECTION("Delete enumerator yields each distinct delete once")
+    {
+        for (const xstring &word : std::vector<xstring>{XL("a"), XL("aab"), XL("mississippi"), XL("abolution")})
+        {
+            for (int distance = 0; distance <= 3; distance++)
+            {
+                // reference: the set of deletes built the way SymSpell used to, one string at a time
+                int len = std::min((int)word.size(), 7);
+                std::set<xstring> expected{word.substr(0, len)};
+                if ((int)word.size() <= distance)
+                    expected.insert(XL(""));
+                std::vector<xstring> level{word.substr(0, len)};
+                for (int d = 0; d < std::max(1, distance); d++)
+                {
+                    std::vector<xstring> next;
+                    for (const xstring &w : level)
+                        for (int i = 0; w.size() > 1 && i < (int)w.size(); i++)
+                        {
+                            xstring del = w;
+                            del.erase(i, 1);
+                            if (expected.insert(del).second)
+                                next.push_back(del);
+                        }
+                    level.swap(next);
+                }
+
+                std::vector<xstring> produced;
+                DeleteEnumerator enumerator;
+                enumerator.ForEach(word.data(), word.size(), 7, distance, [&](const xchar *chars, int length, uint32_t hash)
+                                   {
+                    REQUIRE(hash == DeleteEnumerator::Fnv(chars, length));
+                    produced.emplace_back(chars, length); });
+                REQUIRE(produced.size() == expected.size());
+                REQUIRE(std::set<xstring>(produced.begin(), produced.end()) == expected);
+            }
+        }
+    }
+
+    SECTION("Lookup candidates with repeated chars and long prefixes")
+    {
+        xstring longWord(70, XL('a'));
+        longWord[65] = XL('b');
+        for (int customPrefix : {7, 80})
+        {
+            SymSpell symSpellcustom(maxEditDistance, customPrefix, DEFAULT_COUNT_THRESHOLD, DEFAULT_INITIAL_CAPACITY,
+                                    DEFAULT_COMPACT_LEVEL);
+            auto staging = std::make_shared<SuggestionStage>(100);
+            symSpellcustom.CreateDictionaryEntry(XL("aab"), 5, staging);
+            symSpellcustom.CreateDictionaryEntry(XL("ab"), 3, staging);
+            symSpellcustom.CreateDictionaryEntry(XL("b"), 2, staging);
+            symSpellcustom.CreateDictionaryEntry(longWord, 1, staging);
+            symSpellcustom.CommitStaged(staging);
+
+            auto results = symSpellcustom.Lookup(XL("aaab"), Verbosity::All, 2);
+            REQUIRE(results.size() == 2);
+            REQUIRE(results[0].term == XL("aab"));
+            REQUIRE(results[0].distance == 1);
+            REQUIRE(results[1].term == XL("ab"));
+            REQUIRE(results[1].distance == 2);
+
+            xstring typo = longWord;
+            typo.erase(30, 1);
+            results = symSpellcustom.Lookup(typo, Verbosity::Closest, 2);
+            REQUIRE(results.size() == 1);
+            REQUIRE(results[0].term == longWord);
+            REQUIRE(results[0].distance == 1);
+        }
+    }
+
+    SECTION("Bit-parallel distances match the DP distances")
+    {
+        // plain DP over all cells as the reference, for both metrics
+        auto reference = [](const xstring &a, const xstring &b, bool transpositions)
+        {
+            std::vector<std::vector<int>> d(a.size() + 1, std::vector<int>(b.size() + 1));
+            for (size_t i = 0; i <= a.size(); i++)
+                d[i][0] = i;
+            for (size_t j = 0; j <= b.size(); j++)
+                d[0][j] = j;
+            for (size_t i = 1; i <= a.size(); i++)
+                for (size_t j = 1; j <= b.size(); j++)
+                {
+                    d[i][j] = std::min({d[i - 1][j] + 1, d[i][j - 1] + 1, d[i - 1][j - 1] + (a[i - 1] != b[j - 1])});
+                    if (transpositions && i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1])
+                        d[i][j] = std::min(d[i][j], d[i - 2][j - 2] + 1);
+                }
+            return d[a.size()][b.size()];
+        };
+
+        EditDistance osa(DistanceAlgorithm::DamerauOSADistance);
+        EditDistance levenshtein(DistanceAlgorithm::LevenshteinDistance);
+        unsigned int seed = 7;
+        auto next = [&seed]()
+        { return (seed = seed * 1103515245u + 12345u) >> 16; };
+        for (int n = 0; n < 20000; n++)
+        {
+            // short strings over small alphabets, sometimes longer than a 64 bit pattern
+            int maxLen = n % 10 == 0 ? 80 : 12;
+            xstring a, b;
+            int alphabet = 2 + next() % 4;
+            for (int i = 1 + next() % maxLen; i > 0; i--)
+                a += (xchar)(XL('a') + next() % alphabet);
+            for (int i = 1 + next() % maxLen; i > 0; i--)
+                b += (xchar)(XL('a') + next() % alphabet);
+            int maxDistance = next() % 6;
+            int expected = reference(a, b, true);
+            REQUIRE(osa.Compare(a, b, maxDistance) == (expected <= maxDistance ? expected : -1));
+            expected = reference(a, b, false);
+            REQUIRE(levenshtein.Compare(a, b, maxDistance) == (expected <= maxDistance ? expected : -1));
+        }
+    }
+
+    SECTION("Batch distances match single distances")
+    {
+        BatchDistance simd, scalar;
+        scalar.SetKernel(BatchDistance::Scalar);
+        unsigned int seed = 11;
+        auto next = [&seed]()
+        { return (seed = seed * 1103515245u + 12345u) >> 16; };
+        for (int n = 0; n < 2000; n++)
+        {
+            // patterns on both sides of the 32 char lanes, texts of uneven lengths
+            xstring pattern;
+            int alphabet = 2 + next() % 4;
+            for (int i = 1 + next() % (n % 4 == 0 ? 64 : 12); i > 0; i--)
+                pattern += (xchar)(XL('a') + next() % alphabet);
+            std::vector<xstring> texts(next() % 20);
+            std::vector<const xchar *> chars;
+            std::vector<int> lengths;
+            for (xstring &text : texts)
+            {
+                for (int i = next() % (n % 4 == 0 ? 70 : 14); i > 0; i--)
+                    text += (xchar)(XL('a') + next() % alphabet);
+                chars.push_back(text.data());
+                lengths.push_back(text.size());
+            }
+            int maxDistance = next() % 5;
+            for (auto algorithm : {DistanceAlgorithm::DamerauOSADistance, DistanceAlgorithm::LevenshteinDistance})
+            {
+                EditDistance single(algorithm);
+                std::vector<int> simdDistances(texts.size()), scalarDistances(texts.size());
+                simd.Compare(algorithm, pattern.data(), pattern.size(), chars.data(), lengths.data(), texts.size(),
+                             maxDistance, simdDistances.data());
+                scalar.Compare(algorithm, pattern.data(), pattern.size(), chars.data(), lengths.data(), texts.size(),
+                               maxDistance, scalarDistances.data());
+                for (size_t i = 0; i < texts.size(); i++)
+                {
+                    int expected = single.Compare(pattern, texts[i], maxDistance);
+                    REQUIRE(simdDistances[i] == expected);
+                    REQUIRE(scalarDistances[i] == expected);
+                }
+            }
+        }
+    }
+
+    SECTION("Lookup cache returns cached results until the dictionary changes")
+    {
+        SymSpell symSpell(2, 7);
+        auto staging = std::make_shared<SuggestionStage>(16);
+        symSpell.CreateDictionaryEntry(XL("steam"), 4, staging);
+        symSpell.CreateDictionaryEntry(XL("steams"), 2, staging);
+        symSpell.CommitStaged(staging);
+        symSpell.EnableLookupCache(16);
+        auto first = symSpell.Lookup(XL("streem"), Verbosity::All, 2);
+        auto second = symSpell.Lookup(XL("streem"), Verbosity::All, 2);
+        REQUIRE(first.size() == 1);
+        REQUIRE(first.size() == second.size());
+        for (size_t i = 0; i < first.size(); i++)
+            REQUIRE(first[i].term == second[i].term);
+        REQUIRE(symSpell.LookupCacheStats().hits == 1);
+        REQUIRE(symSpell.LookupCacheStats().misses == 1);
+        REQUIRE(symSpell.Lookup(XL("streem"), Verbosity::Top, 2).size() == 1); // other options, other entry
+        REQUIRE(symSpell.LookupCacheStats().misses == 2);
+
+        staging = std::make_shared<SuggestionStage>(16);
+        symSpell.CreateDictionaryEntry(XL("stream"), 10, staging);
+        symSpell.CommitStaged(staging);
+        auto changed = symSpell.Lookup(XL("streem"), Verbosity::Top, 2);
+        REQUIRE(changed[0].term == XL("stream"));
+        symSpell.DeleteDictionaryEntry(XL("stream"));
+        REQUIRE(symSpell.Lookup(XL("streem"), Verbosity::Top, 2)[0].term == XL("steam"));
+        REQUIRE(symSpell.LookupCacheStats().hits == 1);
+
+        for (int i = 0; i < 40; i++)
+            symSpell.Lookup(XL("steam") + xstring(i % 20 + 1, XL('x')), Verbosity::Top, 2);
+        REQUIRE(symSpell.LookupCacheStats().size <= 16);
+        symSpell.ClearLookupCache();
+        REQUIRE(symSpell.LookupCacheStats().size == 0);
+        REQUIRE(symSpell.LookupCacheStats().hits == 0);
+    }
+
+    SECTION("Word segmentation of long unspaced input")
+    {
+        SymSpell symSpell(maxEditDistance, prefixLength);
+        symSpell.LoadDictionary("../resources/frequency_dictionary_en_82_765.txt", 0, 1, XL(' '));
+        xstring input, expected;
+        for (int i = 0; i < 200; i++)
+        {
+            input += XL("thequickbrownfoxjumpsoverthelazydog");
+            expected += i == 0 ? XL("the quick brown fox jumps over the lazy dog")
+                               : XL(" the quick brown fox jumps over the lazy dog");
+        }
+        auto result = symSpell.WordSegmentation(input);
+        REQUIRE(result.getSegmented() == expected);
+        REQUIRE(result.getCorrected() == expected);
+        REQUIRE(result.getDistance() == 200 * 9 - 1);
+
+        // spaces already in the input are kept, tabs and double spaces are dropped
+        REQUIRE(symSpell.WordSegmentation(XL("the quick\tbrownfox  jumps")).getCorrected() ==
+                XL("the quick brown fox jumps"));
+        REQUIRE(symSpell.WordSegmentation(XL("")).getCorrected().empty());
+    }
+
+    SECTION("Word segmentation of empty input is empty, with zero distance and probability")
+    {
+        SymSpell symSpell(maxEditDistance, prefixLength);
+        symSpell.LoadDictionary("../resources/frequency_dictionary_en_82_765.txt", 0, 1, XL(' '));
+        std::vector<Info> results{Info(), symSpell.WordSegmentation(XL("")),
+                                  symSpell.WordSegmentationBigrams(XL(""), maxEditDistance, 0)};
+        auto batch = symSpell.WordSegmentationBatch({XL(""), XL("")}, maxEditDistance, symSpell.MaxLength(), 2);
+        results.insert(results.end(), batch.begin(), batch.end());
+        for (const Info &result : results)
+        {
+            REQUIRE(result.getSegmented().empty());
+            REQUIRE(result.getCorrected().empty());
+            REQUIRE(result.getDistance() == 0);
+            REQUIRE(result.getProbability() == 0.0);
+        }
+    }
+
+    SECTION("Streaming word segmentation matches the whole text")
+    {
+        SymSpell symSpell(maxEditDistance, prefixLength);
+        symSpell.LoadDictionary("../resources/frequency_dictionary_en_82_765.txt", 0, 1, XL(' '));
+        xstring text = XL("Itwasabright colddayinApril,andtheclockswerestrikngthirteen. ");
+        for (int i = 0; i < 3; i++)
+            text += text;
+        auto whole = symSpell.WordSegmentation(text, 2);
+
+        WordSegmentationStream stream(symSpell, 2, symSpell.MaxLength());
+        for (int chunkSize : {1, 7, 64})
+        {
+            xstring segmented, corrected;
+            for (size_t start = 0; start < text.size(); start += chunkSize)
+            {
+                auto piece = stream.Push(text.substr(start, chunkSize));
+                segmented += piece.getSegmented();
+                corrected += piece.getCorrected();
+            }
+            REQUIRE(!segmented.empty()); // words are committed before the end of the text
+            auto rest = stream.Finish();
+            REQUIRE(segmented + rest.getSegmented() == whole.getSegmented());
+            REQUIRE(corrected + rest.getCorrected() == whole.getCorrected());
+            REQUIRE(stream.Distance() == whole.getDistance());
+            REQUIRE(stream.Probability() == whole.getProbability());
+        }
+    }
+
+    SECTION("Top-K word segmentation starts with the best segmentation")
+    {
+        SymSpell symSpell(maxEditDistance, prefixLength);
+        symSpell.LoadDictionary("../resources/frequency_dictionary_en_82_765.txt", 0, 1, XL(' '));
+        for (const xstring &input : std::vector<xstring>{XL("thequickbrownfoxjumpsoverthelazydog"), XL("itwasabrightcolddayinapril"),
+                                     XL("Whereis th elove")})
+        {
+            auto best = symSpell.WordSegmentation(input, 2);
+            auto results = symSpell.WordSegmentationTopK(input, 5, 2, symSpell.MaxLength());
+            REQUIRE(results.size() > 1);
+            REQUIRE(results.size() <= 5);
+            REQUIRE(results[0].getCorrected() == best.getCorrected());
+            REQUIRE(results[0].getDistance() == best.getDistance());
+            REQUIRE(results[0].getProbability() == best.getProbability());
+            // without spaces in the input, every space of a result is an inserted one
+            auto edits = [](const Info &result)
+            {
+                xstring segmented = result.getSegmented();
+                return result.getDistance() - (int)std::count(segmented.begin(), segmented.end(), XL(' '));
+            };
+            for (size_t i = 1; i < results.size(); i++)
+            {
+                REQUIRE((results[i].getSegmented() != results[0].getSegmented() ||
+                         results[i].getCorrected() != results[0].getCorrected()));
+                if (i > 1 && input.find(XL(' ')) == xstring::npos)
+                    REQUIRE(edits(results[i - 1]) <= edits(results[i]));
+            }
+        }
+        REQUIRE(symSpell.WordSegmentationTopK(XL("a"), 5, 2, symSpell.MaxLength()).size() <= 5);
+        REQUIRE(symSpell.WordSegmentationTopK(XL(""), 5, 2, symSpell.MaxLength()).empty());
+    }
+
+    SECTION("Bigram word segmentation follows the bigram counts")
+    {
+        SymSpell symSpell(maxEditDistance, prefixLength);
+        symSpell.LoadDictionary("../resources/frequency_dictionary_en_82_765.txt", 0, 1, XL(' '));
+        REQUIRE(symSpell.WordSegmentationBigrams(XL("nowhere"), 2, symSpell.MaxLength()).getCorrected() == XL("nowhere"));
+        REQUIRE(symSpell.WordSegmentationBigrams(XL("thequickbrownfoxjumpsoverthelazydog"), 2, symSpell.MaxLength()).getCorrected() ==
+                XL("the quick brown fox jumps over the lazy dog"));
+
+        symSpell.LoadBigramDictionary("../tests/fortests/segmentation_bigrams.txt", 0, 2);
+        REQUIRE(symSpell.BigramCount(XL("now"), XL("here")) == 1000000000);
+        REQUIRE(symSpell.BigramCount(XL("here"), XL("now")) == 0);
+        auto result = symSpell.WordSegmentationBigrams(XL("nowhere"), 2, symSpell.MaxLength());
+        REQUIRE(result.getCorrected() == XL("now here"));
+        REQUIRE(result.getDistance() == 1);
+
+        // the stream gives the same result in chunks
+        WordSegmentationStream stream(symSpell, 2, symSpell.MaxLength(), 1, true);
+        xstring text = XL("itwasnowherenearthethequickbrownfox"), corrected;
+        for (size_t start = 0; start < text.size(); start += 5)
+            corrected += stream.Push(text.substr(start, 5)).getCorrected();
+        corrected += stream.Finish().getCorrected();
+        REQUIRE(corrected == symSpell.WordSegmentationBigrams(text, 2, symSpell.MaxLength()).getCorrected());
+    }
+
+    SECTION("Bigrams are keyed by word ids and kept in the index image")
+    {
+        SymSpell symSpell(maxEditDistance, prefixLength);
+        symSpell.LoadDictionary("../resources/frequency_dictionary_en_82_765.txt", 0, 1, XL(' '));
+        auto wordCount = symSpell.WordCount();
+        REQUIRE(symSpell.LoadBigramDictionary("../tests/fortests/segmentation_bigrams.txt", 0, 2));
+        REQUIRE(symSpell.bigrams.Size() == 1);
+        REQUIRE(symSpell.WordCount() == wordCount);
+        REQUIRE(symSpell.BigramCount(XL("now"), XL("here")) == 1000000000);
+        REQUIRE(symSpell.BigramCount(XL("now"), XL("hereby")) == 0);
+        REQUIRE(symSpell.BigramCount(XL("nowhere"), XL("")) == 0);
+
+        auto filepath = "../resources/index_bigrams.bin";
+        REQUIRE(symSpell.SaveIndex(filepath));
+        SymSpell symSpellMapped(1, 3);
+        REQUIRE(symSpellMapped.LoadIndex(filepath));
+        REQUIRE(symSpellMapped.bigrams.Size() == 1);
+        REQUIRE(symSpellMapped.BigramCount(XL("now"), XL("here")) == 1000000000);
+        REQUIRE(symSpellMapped.BigramCount(XL("here"), XL("now")) == 0);
+        REQUIRE(symSpellMapped.WordSegmentationBigrams(XL("nowhere"), 2, symSpellMapped.MaxLength()).getCorrected() ==
+                XL("now here"));
+        std::remove(filepath);
+    }
+
+    SECTION("Dictionary loader reports malformed lines")
+    {
+        std::vector<size_t> malformed;
+        auto onMalformed = [&](size_t lineNumber, const xstring &, const char *)
+        { malformed.push_back(lineNumber); };
+
+        SymSpell symSpell(maxEditDistance, prefixLength);
+        REQUIRE(symSpell.LoadDictionary("../tests/fortests/malformed_dict.txt", 0, 1, XL(' '), 1, onMalformed));
+        REQUIRE(malformed == std::vector<size_t>{2, 3});
+        REQUIRE(symSpell.WordCount() == 6);
+        REQUIRE(symSpell.Lookup(XL("apple"), Verbosity::Top, 0)[0].count == 10);
+        REQUIRE(symSpell.Lookup(XL("banana"), Verbosity::Top, 0)[0].count == 1);
+        REQUIRE(symSpell.Lookup(XL("date"), Verbosity::Top, 0)[0].count == 1);
+        REQUIRE(symSpell.Lookup(XL("fig"), Verbosity::Top, 0)[0].count == 7);
+
+        malformed.clear();
+        SymSpell symSpellColumns(maxEditDistance, prefixLength);
+        symSpellColumns.LoadDictionary("../tests/fortests/malformed_dict.txt", 0, 2, XL(' '), 1, onMalformed);
+        REQUIRE(malformed == std::vector<size_t>{1, 2, 3, 6, 7});
+        REQUIRE(symSpellColumns.WordCount() == 2);
+
+        malformed.clear();
+        REQUIRE(symSpell.LoadBigramDictionary("../tests/fortests/malformed_dict.txt", 0, 2, XL(' '), onMalformed));
+        REQUIRE(malformed == std::vector<size_t>{5, 6});
+        REQUIRE(symSpell.BigramCount(XL("apple"), XL("10")) == 1);
+        REQUIRE(symSpell.BigramCount(XL("elder"), XL("5")) == 0);
+
+        // in single column mode a line without a space has no second word; its count is not the least bigram count
+        malformed.clear();
+        xstring bigrams = XL("apple pie\t5\nbanana\t1\ncherry tart\t9\n");
+        SymSpell symSpellBigrams(maxEditDistance, prefixLength);
+        REQUIRE(symSpellBigrams.LoadBigramDictionaryBuffer(bigrams.data(), bigrams.size(), 0, 1, XL('\t'), onMalformed));
+        REQUIRE(malformed == std::vector<size_t>{2});
+        REQUIRE(symSpellBigrams.BigramCount(XL("cherry"), XL("tart")) == 9);
+        REQUIRE(symSpellBigrams.BigramLogProbability(XL("apple"), 100, XL("tart"), INT64_MAX) == Approx(log10(0.05)));
+    }
+
+    SECTION("Dictionaries load from buffers and entry lists like from files")
+    {
+        SymSpell symSpell(maxEditDistance, prefixLength);
+        symSpell.LoadDictionary("../resources/frequency_dictionary_en_82_765.txt", 0, 1, XL(' '));
+
+        std::ifstream file("../resources/frequency_dictionary_en_82_765.txt", std::ios::binary);
+        std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        SymSpell symSpellBuffer(maxEditDistance, prefixLength);
+        REQUIRE(symSpellBuffer.LoadDictionaryBuffer(text.data(), text.size(), 0, 1));
+        REQUIRE(symSpell.WordCount() == symSpellBuffer.WordCount());
+        REQUIRE(symSpell.EntryCount() == symSpellBuffer.EntryCount());
+
+        std::vector<std::pair<xstring, int64_t>> entries{{XL("steama"), 4}, {XL("steamb"), 6}, {XL("steamc"), 2},
+                                                         {XL("steama"), 1}};
+        SymSpell symSpellEntries(maxEditDistance, prefixLength);
+        REQUIRE(symSpellEntries.CreateDictionaryEntries(entries) == 3);
+        SymSpell symSpellSingle(maxEditDistance, prefixLength);
+        for (const auto &entry : entries)
+        {
+            auto staging = std::make_shared<SuggestionStage>(128);
+            symSpellSingle.CreateDictionaryEntry(entry.first, entry.second, staging);
+            symSpellSingle.CommitStaged(staging);
+        }
+        REQUIRE(symSpellEntries.EntryCount() == symSpellSingle.EntryCount());
+        auto expected = symSpellSingle.Lookup(XL("steam"), Verbosity::All, 2);
+        auto results = symSpellEntries.Lookup(XL("steam"), Verbosity::All, 2);
+        REQUIRE(expected.size() == 3);
+        REQUIRE(expected.size() == results.size());
+        for (size_t i = 0; i < expected.size(); i++)
+            REQUIRE(expected[i].Equals(results[i]));
+        REQUIRE(results[1].term == XL("steama"));
+        REQUIRE(results[1].count == 5);
+    }
+
+    SECTION("One staging pass matches entries committed one by one")
+    {
+        std::vector<std::pair<xstring, int64_t>> entries;
+        for (const xchar *term : {XL("steama"), XL("steamb"), XL("steamc"), XL("stean"), XL("steam"), XL("streams")})
+            entries.emplace_back(term, 5);
+
+        SymSpell symSpellSingle(maxEditDistance, prefixLength);
+        for (const auto &entry : entries)
+        {
+            auto staging = std::make_shared<SuggestionStage>(128);
+            symSpellSingle.CreateDictionaryEntry(entry.first, entry.second, staging);
+            symSpellSingle.CommitStaged(staging);
+        }
+        SymSpell symSpellStaged(maxEditDistance, prefixLength);
+        auto staging = std::make_shared<SuggestionStage>(128);
+        for (const auto &entry : entries)
+            symSpellStaged.CreateDictionaryEntry(entry.first, entry.second, staging);
+        REQUIRE(symSpellStaged.EntryCount() == 0);
+        symSpellStaged.CommitStaged(staging);
+        SymSpell symSpellBatch(maxEditDistance, prefixLength);
+        REQUIRE(symSpellBatch.CreateDictionaryEntries(entries) == entries.size());
+
+        REQUIRE(symSpellStaged.EntryCount() == symSpellSingle.EntryCount());
+        REQUIRE(symSpellBatch.EntryCount() == symSpellSingle.EntryCount());
+        for (const xchar *term : {XL("steam"), XL("stea"), XL("stream")})
+        {
+            auto expected = symSpellSingle.Lookup(term, Verbosity::All, 2);
+            auto staged = symSpellStaged.Lookup(term, Verbosity::All, 2);
+            auto batch = symSpellBatch.Lookup(term, Verbosity::All, 2);
+            REQUIRE(expected.size() == staged.size());
+            REQUIRE(expected.size() == batch.size());
+            for (size_t i = 0; i < expected.size(); i++)
+            {
+                REQUIRE(expected[i].Equals(staged[i]));
+                REQUIRE(expected[i].Equals(batch[i]));
+            }
+        }
+    }
+
+    SECTION("Entries added without staging are suggested right away")
+    {
+        for (bool frozenIndex : {false, true})
+        {
+            SymSpell symSpell(maxEditDistance, prefixLength, DEFAULT_COUNT_THRESHOLD, DEFAULT_INITIAL_CAPACITY,
+                              DEFAULT_COMPACT_LEVEL, frozenIndex);
+            SymSpell symSpellStaged(maxEditDistance, prefixLength, DEFAULT_COUNT_THRESHOLD, DEFAULT_INITIAL_CAPACITY,
+                                    DEFAULT_COMPACT_LEVEL, frozenIndex);
+            for (const xchar *term : {XL("steam"), XL("steama"), XL("steamb"), XL("stream"), XL("steam")})
+            {
+                symSpell.CreateDictionaryEntry(term, 10, nullptr);
+                auto staging = std::make_shared<SuggestionStage>(128);
+                symSpellStaged.CreateDictionaryEntry(term, 10, staging);
+                symSpellStaged.CommitStaged(staging);
+            }
+            auto results = symSpell.Lookup(XL("steam"), Verbosity::All, 2);
+            auto expected = symSpellStaged.Lookup(XL("steam"), Verbosity::All, 2);
+            REQUIRE(results.size() == 4);
+            REQUIRE(results[0].term == XL("steam"));
+            REQUIRE(results[0].count == 20);
+            REQUIRE(expected.size() == results.size());
+            for (size_t i = 0; i < expected.size(); i++)
+                REQUIRE(expected[i].Equals(results[i]));
+        }
+    }
+
+    SECTION("Deleted words leave the index as if never added")
+    {
+        std::vector<xstring> removed{XL("the"), XL("abolition"), XL("intermediate"), XL("extrinsic"),
+                                     XL("antidisestablishmentarianism"), XL("notaword")};
+        std::ifstream file("../resources/frequency_dictionary_en_82_765.txt", std::ios::binary);
+        std::string text, kept, line;
+        while (std::getline(file, line))
+        {
+            text += line + "\n";
+            if (std::find(removed.begin(), removed.end(), line.substr(0, line.find(' '))) == removed.end())
+                kept += line + "\n";
+        }
+        for (bool frozenIndex : {false, true})
+        {
+            SymSpell symSpell(maxEditDistance, prefixLength, DEFAULT_COUNT_THRESHOLD, DEFAULT_INITIAL_CAPACITY,
+                              DEFAULT_COMPACT_LEVEL, frozenIndex);
+            symSpell.LoadDictionaryBuffer(text.data(), text.size(), 0, 1);
+            REQUIRE(symSpell.MaxLength() == 28);
+            REQUIRE(symSpell.DeleteDictionaryEntries(removed) == 5);
+            REQUIRE_FALSE(symSpell.DeleteDictionaryEntry(XL("the")));
+            REQUIRE(symSpell.MaxLength() == 23);
+            if (frozenIndex)
+                symSpell.CompactIndex();
+
+            SymSpell expected(maxEditDistance, prefixLength, DEFAULT_COUNT_THRESHOLD, DEFAULT_INITIAL_CAPACITY,
+                              DEFAULT_COMPACT_LEVEL, frozenIndex);
+            expected.LoadDictionaryBuffer(kept.data(), kept.size(), 0, 1);
+            REQUIRE(symSpell.WordCount() == expected.WordCount());
+            REQUIRE(symSpell.EntryCount() == expected.EntryCount());
+            for (const xchar *word : {XL("tke"), XL("abolution"), XL("intermedaite"), XL("extrine"), XL("elipnaht")})
+            {
+                auto results = symSpell.Lookup(word, Verbosity::All, 2);
+                auto expectedResults = expected.Lookup(word, Verbosity::All, 2);
+                REQUIRE(results.size() == expectedResults.size());
+                for (size_t i = 0; i < results.size(); i++)
+                    REQUIRE(results[i].Equals(expectedResults[i]));
+            }
+        }
+    }
+
+    SECTION("Deleted words added again are listed once in the frozen index")
+    {
+        struct InspectedSymSpell : SymSpell
+        {
+            using SymSpell::SymSpell;
+            size_t FrozenIdCount() const { return frozenDeletes->IdCount(); }
+        };
+        InspectedSymSpell symSpell(maxEditDistance, prefixLength, DEFAULT_COUNT_THRESHOLD, DEFAULT_INITIAL_CAPACITY,
+                                   DEFAULT_COMPACT_LEVEL, true);
+        symSpell.LoadDictionary("../resources/frequency_dictionary_en_82_765.txt", 0, 1, XL(' '));
+        size_t idCount = symSpell.FrozenIdCount();
+        std::vector<xstring> toggled{XL("abolition"), XL("intermediate"), XL("extrinsic")};
+        std::vector<int64_t> counts;
+        for (const xstring &word : toggled)
+            counts.push_back(symSpell.Lookup(word, Verbosity::Top, 0)[0].count);
+        auto expected = symSpell.Lookup(XL("abolution"), Verbosity::All, 2);
+
+        REQUIRE(symSpell.DeleteDictionaryEntries(toggled) == toggled.size());
+        auto staging = std::make_shared<SuggestionStage>(16384);
+        for (size_t i = 0; i < toggled.size(); i++)
+            REQUIRE(symSpell.CreateDictionaryEntry(toggled[i], counts[i], staging));
+        symSpell.CommitStaged(staging);
+        symSpell.CompactIndex();
+        REQUIRE(symSpell.FrozenIdCount() == idCount);
+        auto results = symSpell.Lookup(XL("abolution"), Verbosity::All, 2);
+        REQUIRE(results.size() == expected.size());
+        for (size_t i = 0; i < results.size(); i++)
+            REQUIRE(results[i].Equals(expected[i]));
+    }
+
+    SECTION("Only words still in the frozen index compact it when added again")
+    {
+        struct InspectedSymSpell : SymSpell
+        {
+            using SymSpell::SymSpell;
+            size_t Tombstones() const { return frozenTombstones; }
+            size_t FrozenIdCount() const { return frozenDeletes->IdCount(); }
+        };
+        InspectedSymSpell symSpell(maxEditDistance, prefixLength, 10, DEFAULT_INITIAL_CAPACITY,
+                                   DEFAULT_COMPACT_LEVEL, true);
+        auto staging = std::make_shared<SuggestionStage>(16);
+        for (const xchar *word : {XL("steam"), XL("stream"), XL("dream"), XL("cream"), XL("scream"),
+                                    XL("strain"), XL("stain"), XL("train"), XL("drain"), XL("brain")})
+            symSpell.CreateDictionaryEntry(word, 100, staging);
+        symSpell.CommitStaged(staging);
+        const xstring bigramText = XL("steam engine 5\n");
+        REQUIRE(symSpell.LoadBigramDictionaryBuffer(bigramText.data(), bigramText.size(), 0, 2));
+        REQUIRE(symSpell.DeleteDictionaryEntry(XL("steam")));
+        REQUIRE(symSpell.Tombstones() == 1);
+        size_t idCount = symSpell.FrozenIdCount();
+
+        // a word only seen in a bigram, and a word deleted before it was ever frozen, leave the tombstone alone
+        REQUIRE(symSpell.CreateDictionaryEntry(XL("engine"), 100, nullptr));
+        REQUIRE(symSpell.CreateDictionaryEntry(XL("gleam"), 100, nullptr));
+        REQUIRE(symSpell.DeleteDictionaryEntry(XL("gleam")));
+        REQUIRE(symSpell.CreateDictionaryEntry(XL("gleam"), 100, nullptr));
+        REQUIRE(symSpell.Tombstones() == 1);
+        REQUIRE(symSpell.FrozenIdCount() == idCount);
+
+        // the deleted word comes back below the threshold first, and compacts once it is a word again
+        REQUIRE_FALSE(symSpell.CreateDictionaryEntry(XL("steam"), 5, nullptr));
+        REQUIRE(symSpell.Tombstones() == 1);
+        REQUIRE(symSpell.CreateDictionaryEntry(XL("steam"), 5, nullptr));
+        REQUIRE(symSpell.Tombstones() == 0);
+        REQUIRE(symSpell.Lookup(XL("stean"), Verbosity::All, 1).size() == 1);
+    }
+
+    SECTION("Buckets of words too short or too long for the input are skipped without changing results")
+    {
+        // long words share the prefix deletes of short ones, which is where whole buckets are passed over
+        std::vector<std::pair<xstring, int64_t>> entries;
+        for (const xstring &stem : std::vector<xstring>{XL("steam"), XL("stream"), XL("strea"), XL("sta"), XL("st")})
+        {
+            entries.emplace_back(stem, 100);
+            for (const xstring &suffix : std::vector<xstring>{XL("s"), XL("er"), XL("ing"), XL("boats"), XL("rollers"), XL("ingmachinery")})
+                entries.emplace_back(stem + suffix, 10 + (int64_t)suffix.size());
+        }
+        LengthHistogram lengths;
+        for (const auto &entry : entries)
+            lengths.Add(entry.first.size());
+        REQUIRE(lengths.Any(0, 2));
+        REQUIRE_FALSE(lengths.Any(16, 16));
+        REQUIRE(lengths.Any(16, 40));
+        REQUIRE_FALSE(lengths.Any(19, 40));
+
+        EditDistance osa(DistanceAlgorithm::DamerauOSADistance);
+        for (int prefix : {prefixLength, 20})
+        {
+            for (bool frozenIndex : {false, true})
+            {
+                SymSpell symSpell(maxEditDistance, prefix, DEFAULT_COUNT_THRESHOLD, DEFAULT_INITIAL_CAPACITY,
+                                  DEFAULT_COMPACT_LEVEL, frozenIndex);
+                symSpell.CreateDictionaryEntries(entries);
+                for (const xchar *input : {XL("stem"), XL("steamboat"), XL("stremrollers"), XL("s"), XL("xyz"),
+                                             XL("steamingmachinary"), XL("stingmachinerys"), XL("averyverylongword")})
+                {
+                    std::vector<SuggestItem> expected;
+                    for (const auto &entry : entries)
+                    {
+                        int distance = osa.Compare(input, entry.first, maxEditDistance);
+                        if (distance >= 0)
+                            expected.emplace_back(entry.first, distance, entry.second);
+                    }
+                    std::sort(expected.begin(), expected.end(), SuggestItem::compare);
+                    auto results = symSpell.Lookup(input, Verbosity::All, maxEditDistance);
+                    REQUIRE(results.size() == expected.size());
+                    for (size_t i = 0; i < results.size(); i++)
+                        REQUIRE(results[i].Equals(expected[i]));
+                    auto closest = symSpell.Lookup(input, Verbosity::Closest, maxEditDistance);
+                    for (size_t i = 0; i < closest.size(); i++)
+                        REQUIRE(closest[i].Equals(expected[i]));
+                    REQUIRE(closest.size() == (size_t)std::count_if(expected.begin(), expected.end(), [&](const SuggestItem &item)
+                                                            { return item.distance == expected[0].distance; }));
+                }
+            }
+        }
+    }
+
+    SECTION("Delete buckets keep their ids ordered by length")
+    {
+        DeleteBucket bucket;
+        for (uint32_t id = 0; id < 100; id++)
+            bucket.Add(id, 3 + (id * 7) % 5);
+        REQUIRE(bucket.sorted >= 88);
+        bucket.Sort();
+        REQUIRE(bucket.sorted == 100);
+        for (uint32_t i = 1; i < 100; i++)
+        {
+            REQUIRE(bucket.lengths[i - 1] <= bucket.lengths[i]);
+            if (bucket.lengths[i - 1] == bucket.lengths[i])
+                REQUIRE(bucket.ids[i - 1] < bucket.ids[i]);
+        }
+        bucket.Filter([](uint32_t id)
+                      { return id % 2 == 0; },
+                      [](uint32_t id)
+                      { return 3 + (id * 7) % 5; });
+        REQUIRE(bucket.ids.size() == 50);
+        REQUIRE(bucket.sorted == 50);
+        REQUIRE(std::is_sorted(bucket.lengths.begin(), bucket.lengths.end()));
+        REQUIRE(bucket.range.min == 3);
+        REQUIRE(bucket.range.max == 7);
+
+        // the same lookups with entries added one at a time (sorted parts and unsorted tails), in bulk,
+        // frozen and mapped from an index image
+        std::vector<xstring> terms;
+        std::ifstream file("../resources/frequency_dictionary_en_82_765.txt");
+        std::string line;
+        while (std::getline(file, line) && terms.size() < 5000)
+            terms.push_back(line.substr(0, line.find(' ')));
+        SymSpell single(maxEditDistance, prefixLength);
+        for (const xstring &term : terms)
+            single.CreateDictionaryEntry(term, 10, nullptr);
+        std::vector<std::pair<xstring, int64_t>> entries;
+        for (const xstring &term : terms)
+            entries.emplace_back(term, 10);
+        SymSpell bulk(maxEditDistance, prefixLength);
+        bulk.CreateDictionaryEntries(entries);
+        SymSpell frozen(maxEditDistance, prefixLength, DEFAULT_COUNT_THRESHOLD, DEFAULT_INITIAL_CAPACITY,
+                        DEFAULT_COMPACT_LEVEL, true);
+        frozen.CreateDictionaryEntries(entries);
+        REQUIRE(single.SaveIndex("sorted_buckets.idx"));
+        SymSpell mapped(maxEditDistance, prefixLength);
+        REQUIRE(mapped.LoadIndex("sorted_buckets.idx"));
+        for (const xchar *input : {XL("tke"), XL("abolution"), XL("intermedaite"), XL("a"), XL("govrnment"), XL("xq")})
+        {
+            auto expected = single.Lookup(input, Verbosity::All, maxEditDistance);
+            for (SymSpell *symSpell : {&bulk, &frozen, &mapped})
+            {
+                auto results = symSpell->Lookup(input, Verbosity::All, maxEditDistance);
+                REQUIRE(results.size() == expected.size());
+                for (size_t i = 0; i < results.size(); i++)
+                    REQUIRE(results[i].Equals(expected[i]));
+            }
+        }
+        std::remove("sorted_buckets.idx");
+    }
+
+    SECTION("Character signatures bound the edit distance from below")
+    {
+        REQUIRE(CharSignature::LowerBound(CharSignature::Of(XL("abc"), 3), CharSignature::Of(XL("xyz"), 3)) == 3);
+        REQUIRE(CharSignature::LowerBound(CharSignature::Of(XL("steam"), 5), CharSignature::Of(XL("stema"), 5)) == 0);
+        REQUIRE(CharSignature::LowerBound(CharSignature::Of(XL("steam"), 5), CharSignature::Of(XL("steamboat"), 9)) == 2);
+
+        EditDistance osa(DistanceAlgorithm::DamerauOSADistance);
+        unsigned int seed = 11;
+        auto next = [&seed]()
+        { return (seed = seed * 1103515245u + 12345u) >> 16; };
+        for (int n = 0; n < 5000; n++)
+        {
+            // alphabets wider than 64 characters make characters share signature bits
+            xstring a, b;
+            int alphabet = 2 + next() % 90;
+            for (int i = next() % 12; i > 0; i--)
+                a += (xchar)(XL('!') + next() % alphabet);
+            for (int i = next() % 12; i > 0; i--)
+                b += (xchar)(XL('!') + next() % alphabet);
+            int bound = CharSignature::LowerBound(CharSignature::Of(a.data(), a.size()), CharSignature::Of(b.data(), b.size()));
+            REQUIRE(bound <= osa.Compare(a, b, 100));
+        }
+    }
+
+    SECTION("64-bit delete hashers give every delete its own bucket")
+    {
+        REQUIRE(DeleteHashing::WyHash(XL("steam"), 5) == DeleteHashing::WyHash(xstring(XL("steam")).data(), 5));
+        REQUIRE(DeleteHashing::WyHash(XL("steam"), 5) != DeleteHashing::WyHash(XL("steam"), 4));
+        REQUIRE(DeleteHashing::WyHash(XL(""), 0) != DeleteHashing::WyHash(XL("a"), 1));
+        REQUIRE(DeleteHashing::Fnv64(XL("ab"), 2) != DeleteHashing::Fnv64(XL("ba"), 2));
+
+        std::vector<std::unique_ptr<SymSpell>> symSpells;
+        for (DeleteHasher hasher : {Fnv32, Fnv64, WyHash})
+        {
+            symSpells.emplace_back(new SymSpell(maxEditDistance, 7, DEFAULT_COUNT_THRESHOLD, DEFAULT_INITIAL_CAPACITY,
+                                                DEFAULT_COMPACT_LEVEL, false, hasher));
+            symSpells.back()->LoadDictionary("../resources/frequency_dictionary_en_82_765.txt", 0, 1, XL(' '));
+            REQUIRE(symSpells.back()->Hasher() == hasher);
+        }
+        // the 32-bit keys merge some deletes into shared buckets, the 64-bit keys none
+        REQUIRE(symSpells[0]->EntryCount() < symSpells[1]->EntryCount());
+        REQUIRE(symSpells[1]->EntryCount() == symSpells[2]->EntryCount());
+        for (const xchar *word : {XL("tke"), XL("abolution"), XL("intermedaite"), XL("extrine"), XL("a")})
+        {
+            auto expected = symSpells[0]->Lookup(word, Verbosity::All, maxEditDistance);
+            for (int h = 1; h < 3; h++)
+            {
+                auto results = symSpells[h]->Lookup(word, Verbosity::All, maxEditDistance);
+                REQUIRE(results.size() == expected.size());
+                for (size_t i = 0; i < results.size(); i++)
+                    REQUIRE(results[i].Equals(expected[i]));
+            }
+        }
+
+        REQUIRE(symSpells[2]->SaveIndex("wyhash.idx"));
+        SymSpell mapped;
+        REQUIRE(mapped.LoadIndex("wyhash.idx"));
+        REQUIRE(mapped.Hasher() == WyHash);
+        REQUIRE(mapped.Lookup(XL("abolution"), Verbosity::Closest, maxEditDistance)[0].term == XL("abolition"));
+        std::remove("wyhash.idx");
+    }
+
+    SECTION("Lookups see the dictionary before or after a concurrent change, never in between")
+    {
+        SymSpell symSpell(maxEditDistance, prefixLength, DEFAULT_COUNT_THRESHOLD, DEFAULT_INITIAL_CAPACITY,
+                          DEFAULT_COMPACT_LEVEL, true);
+        symSpell.LoadDictionary("../resources/frequency_dictionary_en_82_765.txt", 0, 1, XL(' '));
+        std::vector<xstring> toggled{XL("abolition"), XL("intermediate"), XL("extrinsic")};
+        std::vector<xstring> queries{XL("abolution"), XL("intermedaite"), XL("extrine")};
+        std::vector<int64_t> counts;
+        for (const xstring &word : toggled)
+            counts.push_back(symSpell.Lookup(word, Verbosity::Top, 0)[0].count);
+        auto with = symSpell.LookupBatch(queries, Verbosity::All, 2, false, false, 1);
+        symSpell.DeleteDictionaryEntries(toggled);
+        auto without = symSpell.LookupBatch(queries, Verbosity::All, 2, false, false, 1);
+        symSpell.CompactIndex();
+        for (size_t i = 0; i < toggled.size(); i++)
+            symSpell.CreateDictionaryEntry(toggled[i], counts[i], nullptr);
+
+        auto same = [](const std::vector<SuggestItem> &a, const std::vector<SuggestItem> &b)
+        {
+            if (a.size() != b.size())
+                return false;
+            for (size_t i = 0; i < a.size(); i++)
+                if (!a[i].Equals(b[i]))
+                    return false;
+            return true;
+        };
+        std::atomic<bool> done(false);
+        std::atomic<int> lookups(0), mismatches(0);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 3; t++)
+            threads.emplace_back([&, t]()
+                                 {
+                                     while (!done)
+                                     {
+                                         auto results = symSpell.Lookup(queries[t], Verbosity::All, 2);
+                                         if (!same(results, with[t]) && !same(results, without[t]))
+                                             mismatches++;
+                                         lookups++;
+                                     } });
+        threads.emplace_back([&]()
+                             {
+                                 while (!done)
+                                 {
+                                     auto results = symSpell.LookupBatch(queries, Verbosity::All, 2, false, false, 2);
+                                     for (size_t i = 0; i < queries.size(); i++)
+                                         if (!same(results[i], with[i]) && !same(results[i], without[i]))
+                                             mismatches++;
+                                 } });
+        for (int round = 0; round < 20; round++)
+        {
+            REQUIRE(symSpell.DeleteDictionaryEntries(toggled) == toggled.size());
+            symSpell.CompactIndex();
+            for (size_t i = 0; i < toggled.size(); i++)
+                REQUIRE(symSpell.CreateDictionaryEntry(toggled[i], counts[i], nullptr));
+        }
+        done = true;
+        for (auto &thread : threads)
+            thread.join();
+        REQUIRE(mismatches == 0);
+        REQUIRE(lookups > 0);
+    }
+
     SECTION("check save works fine.")
     {
         SymSpell symSpellcustom(maxEditDistance, prefixLength, DEFAULT_COUNT_THRESHOLD, DEFAULT_INITIAL_CAPACITY,
@@ -167,6 +1248,67 @@ TEST_CASE("Testing English", "[english]")
         std::remove(filepath);
     }
 
+    SECTION("Pickles keep the words deleted from a frozen index")
+    {
+        struct InspectedSymSpell : SymSpell
+        {
+            using SymSpell::SymSpell;
+            size_t Tombstones() const { return frozenTombstones; }
+        };
+        InspectedSymSpell symSpell(maxEditDistance, prefixLength, DEFAULT_COUNT_THRESHOLD, DEFAULT_INITIAL_CAPACITY,
+                                   DEFAULT_COMPACT_LEVEL, true);
+        symSpell.LoadDictionary("../resources/frequency_dictionary_en_82_765.txt", 0, 1, XL(' '));
+        REQUIRE(symSpell.DeleteDictionaryEntries({XL("abolition"), XL("intermediate")}) == 2);
+        REQUIRE(symSpell.Tombstones() == 2);
+
+        std::stringstream stream;
+        {
+            cereal::BinaryOutputArchive oarchive(stream);
+            oarchive(symSpell);
+        }
+        REQUIRE(symSpell.Tombstones() == 2);
+        REQUIRE(symSpell.MaxLength() == 28);
+
+        InspectedSymSpell loaded(maxEditDistance, prefixLength);
+        {
+            cereal::BinaryInputArchive iarchive(stream);
+            iarchive(loaded);
+        }
+        REQUIRE(loaded.Tombstones() == 2);
+        REQUIRE(loaded.WordCount() == symSpell.WordCount());
+        REQUIRE(loaded.MaxLength() == 28);
+        REQUIRE(loaded.Lookup(XL("abolution"), Verbosity::Closest, 2)[0].term != XL("abolition"));
+        loaded.CompactIndex();
+        REQUIRE(loaded.Tombstones() == 0);
+    }
+
+    SECTION("Pickles keep the bigrams of their own word table")
+    {
+        const xstring bigramText = XL("apple pie 77\nzebra yak 3\n");
+        SymSpell symSpell(maxEditDistance, prefixLength);
+        REQUIRE(symSpell.LoadBigramDictionaryBuffer(bigramText.data(), bigramText.size(), 0, 2));
+        REQUIRE(symSpell.BigramCount(XL("apple"), XL("pie")) == 77);
+
+        // same words, interned in another order, with one bigram of its own
+        const xstring otherBigramText = XL("yak zebra 5\n");
+        SymSpell other(maxEditDistance, prefixLength);
+        other.CreateDictionaryEntries({{XL("zebra"), 10}, {XL("yak"), 20}, {XL("apple"), 30}, {XL("pie"), 40}});
+        REQUIRE(other.LoadBigramDictionaryBuffer(otherBigramText.data(), otherBigramText.size(), 0, 2));
+        std::stringstream stream;
+        {
+            cereal::BinaryOutputArchive oarchive(stream);
+            oarchive(other);
+        }
+        {
+            cereal::BinaryInputArchive iarchive(stream);
+            iarchive(symSpell);
+        }
+        REQUIRE(symSpell.BigramCount(XL("apple"), XL("pie")) == 0);
+        REQUIRE(symSpell.BigramCount(XL("zebra"), XL("yak")) == 0);
+        REQUIRE(symSpell.BigramCount(XL("yak"), XL("zebra")) == 5);
+        REQUIRE(symSpell.bigramCountMin == 5);
+    }
+
     SECTION("Compund mistakes distance")
     {
         SymSpell symSpell(maxEditDistance, prefixLength);
@@ -1,7 +1,8 @@
 import unittest
-from SymSpellCppPy import SymSpell, Verbosity, SuggestItem
+from SymSpellCppPy import SymSpell, Verbosity, SuggestItem, SuggestionStage, WordSegmentationStream, DeleteHasher
 import os
 import sys
+import threading
 
 
 class SymSpellCppPyTests(unittest.TestCase):
@@ -222,6 +223,55 @@ class SymSpellCppPyTests(unittest.TestCase):
             dictionary_path, 0, 1))
         self.assertEqual(7, sym_spell.word_count())
 
+    def test_load_dictionary_malformed_lines(self):
+        dictionary_path = os.path.join(self.fortests_path, "malformed_dict.txt")
+        sym_spell = SymSpell(2, 7)
+        self.assertEqual(True, sym_spell.load_dictionary(dictionary_path, 0, 1))
+        self.assertEqual(6, sym_spell.word_count())
+        self.assertEqual(10, sym_spell.lookup("apple", Verbosity.TOP, 0)[0].count)
+
+    def test_load_dictionary_buffer(self):
+        with open(self.dictionary_path, "rb") as f:
+            text = f.read()
+        sym_spell = SymSpell(2, 7)
+        self.assertEqual(True, sym_spell.load_dictionary_buffer(text, 0, 1))
+        sym_spell_view = SymSpell(2, 7)
+        self.assertEqual(True, sym_spell_view.load_dictionary_buffer(memoryview(text), 0, 1))
+        self.assertEqual(sym_spell.word_count(), sym_spell_view.word_count())
+        sym_spell_file = SymSpell(2, 7)
+        sym_spell_file.load_dictionary(self.dictionary_path, 0, 1)
+        self.assertEqual(sym_spell_file.word_count(), sym_spell.word_count())
+        self.assertEqual("the", sym_spell.lookup("tke", Verbosity.TOP, 1)[0].term)
+        with self.assertRaises(TypeError):
+            sym_spell.load_dictionary_buffer("the 100", 0, 1)
+
+    def test_create_dictionary_entries(self):
+        sym_spell = SymSpell(2, 7)
+        self.assertEqual(2, sym_spell.create_dictionary_entries({"Steama": 4, "steamb": 6}.items()))
+        self.assertEqual(0, sym_spell.create_dictionary_entries([("steama", 1)]))
+        result = sym_spell.lookup("steam", Verbosity.ALL, 2)
+        self.assertEqual([("steamb", 6), ("steama", 5)], [(s.term, s.count) for s in result])
+
+    def test_staged_dictionary_entries(self):
+        sym_spell = SymSpell(2, 7)
+        staging = SuggestionStage(128)
+        self.assertEqual(True, sym_spell.create_dictionary_entry("steama", 4, staging))
+        self.assertEqual(True, sym_spell.create_dictionary_entry("steamb", 6, staging))
+        self.assertEqual(False, sym_spell.create_dictionary_entry("steama", 1, staging))
+        self.assertEqual(0, sym_spell.entry_count())
+        self.assertGreater(staging.delete_count(), 0)
+        sym_spell.commit_staged(staging)
+        result = sym_spell.lookup("steam", Verbosity.ALL, 2)
+        self.assertEqual([("steamb", 6), ("steama", 5)], [(s.term, s.count) for s in result])
+
+    def test_add_entries(self):
+        sym_spell = SymSpell(2, 7)
+        self.assertEqual(2, sym_spell.add_entries(["steama", "Steamb", "steama"], [4, 6, 1]))
+        result = sym_spell.lookup("steam", Verbosity.ALL, 2)
+        self.assertEqual([("steamb", 6), ("steama", 5)], [(s.term, s.count) for s in result])
+        with self.assertRaises(ValueError):
+            sym_spell.add_entries(["steamc"], [1, 2])
+
     def test_load_dictionary_separator(self):
         dictionary_path = os.path.join(self.fortests_path,
                                        "separator_dict.txt")
@@ -252,6 +302,74 @@ class SymSpellCppPyTests(unittest.TestCase):
                                                    edit_distance_max))
         self.assertEqual(4945, result_sum)
 
+    def test_frozen_index_should_replicate_noisy_results(self):
+        query_path = os.path.join(self.fortests_path,
+                                  "noisy_query_en_1000.txt")
+        sym_spell = SymSpell(2, 7, frozen_index=True)
+        sym_spell.load_dictionary(self.dictionary_path, 0, 1)
+        self.assertEqual(self.symSpell.entry_count(), sym_spell.entry_count())
+
+        with open(query_path, "r") as infile:
+            for line in infile.readlines():
+                line_parts = line.rstrip().split(" ")
+                if len(line_parts) >= 2:
+                    self.assertEqual(self.symSpell.lookup(line_parts[0], Verbosity.CLOSEST, 2),
+                                     sym_spell.lookup(line_parts[0], Verbosity.CLOSEST, 2))
+
+    def test_parallel_load_should_replicate_noisy_results(self):
+        query_path = os.path.join(self.fortests_path,
+                                  "noisy_query_en_1000.txt")
+        sym_spell = SymSpell()
+        sym_spell.load_dictionary(self.dictionary_path, 0, 1, threads=4)
+        self.assertEqual(self.symSpell.entry_count(), sym_spell.entry_count())
+        self.assertEqual(self.symSpell.word_count(), sym_spell.word_count())
+
+        with open(query_path, "r") as infile:
+            for line in infile.readlines():
+                line_parts = line.rstrip().split(" ")
+                if len(line_parts) >= 2:
+                    self.assertEqual(self.symSpell.lookup(line_parts[0], Verbosity.ALL, 2),
+                                     sym_spell.lookup(line_parts[0], Verbosity.ALL, 2))
+
+    def test_lookup_batch_should_replicate_noisy_results(self):
+        query_path = os.path.join(self.fortests_path,
+                                  "noisy_query_en_1000.txt")
+        test_list = []
+        with open(query_path, "r") as infile:
+            for line in infile.readlines():
+                line_parts = line.rstrip().split(" ")
+                if len(line_parts) >= 2:
+                    test_list.append(line_parts[0])
+
+        results = self.symSpell.lookup_batch(test_list, Verbosity.CLOSEST, 2, threads=4)
+        self.assertEqual(len(test_list), len(results))
+        self.assertEqual(4945, sum(len(result) for result in results))
+        for phrase, result in zip(test_list, results):
+            self.assertEqual(self.symSpell.lookup(phrase, Verbosity.CLOSEST, 2), result)
+
+    def test_lookup_compound_and_word_segmentation_batch(self):
+        phrases = ["whereis th elove", "in te dhird qarter oflast jear", "thequickbrownfoxjumpsoverthelazydog"]
+        compound = self.symSpell.lookup_compound_batch(phrases, 2)
+        segmented = self.symSpell.word_segmentation_batch(phrases)
+        for phrase, result, info in zip(phrases, compound, segmented):
+            self.assertEqual(self.symSpell.lookup_compound(phrase, 2)[0].term, result[0].term)
+            self.assertEqual(self.symSpell.word_segmentation(phrase).get_corrected(), info.get_corrected())
+
+    def test_lookup_cache_should_count_hits_and_invalidate(self):
+        sym_spell = SymSpell(2, 7)
+        sym_spell.create_dictionary_entry("steam", 4)
+        self.assertEqual(sym_spell.lookup_cache_stats()["capacity"], 0)
+        sym_spell.enable_lookup_cache(100)
+        self.assertEqual("steam", sym_spell.lookup("streem", Verbosity.TOP, 2)[0].term)
+        self.assertEqual("steam", sym_spell.lookup("streem", Verbosity.TOP, 2)[0].term)
+        stats = sym_spell.lookup_cache_stats()
+        self.assertEqual((stats["hits"], stats["misses"], stats["size"]), (1, 1, 1))
+
+        sym_spell.create_dictionary_entry("stream", 10)
+        self.assertEqual("stream", sym_spell.lookup("streem", Verbosity.TOP, 2)[0].term)
+        sym_spell.clear_lookup_cache()
+        self.assertEqual(sym_spell.lookup_cache_stats()["hits"], 0)
+
     def test_lookup_compound(self):
         edit_distance_max = 2
         prefix_length = 7
@@ -509,6 +627,68 @@ class SymSpellCppPyTests(unittest.TestCase):
         result = sym_spell.word_segmentation(typo)
         self.assertEqual(correction, result.corrected_string)
 
+    def test_word_segmentation_stream(self):
+        sym_spell = SymSpell(0, 7)
+        sym_spell.load_dictionary(self.dictionary_path, 0, 1)
+        text = "thequickbrownfoxjumpsoverthelazydog" * 20
+        expected = sym_spell.word_segmentation(text, 0)
+
+        stream = WordSegmentationStream(sym_spell, 0)
+        segmented = ""
+        for start in range(0, len(text), 9):
+            segmented += stream.push(text[start:start + 9]).segmented_string
+        self.assertTrue(segmented.startswith("the quick brown fox"))
+        segmented += stream.finish().segmented_string
+        self.assertEqual(expected.segmented_string, segmented)
+        self.assertEqual(expected.distance_sum, stream.distance())
+
+    def test_word_segmentation_stream_pushed_from_two_threads(self):
+        sym_spell = SymSpell(0, 7)
+        sym_spell.load_dictionary(self.dictionary_path, 0, 1)
+        phrase = "thequickbrownfoxjumpsoverthelazydog"
+        expected = sym_spell.word_segmentation(phrase * 400, 0)
+
+        # every chunk is the whole phrase, so any order of the pushes gives the same text
+        stream = WordSegmentationStream(sym_spell, 0)
+        pieces = []
+
+        def push():
+            for _ in range(200):
+                pieces.append(stream.push(phrase).segmented_string)
+
+        threads = [threading.Thread(target=push) for _ in range(2)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        pieces.append(stream.finish().segmented_string)
+        self.assertEqual(sorted(expected.segmented_string.split()), sorted(" ".join(pieces).split()))
+        self.assertEqual(expected.distance_sum, stream.distance())
+
+    def test_word_segmentation_top_k(self):
+        sym_spell = SymSpell(2, 7)
+        sym_spell.load_dictionary(self.dictionary_path, 0, 1)
+        typo = "thequickbrownfoxjumpsoverthelazydog"
+        best = sym_spell.word_segmentation(typo)
+        results = sym_spell.word_segmentation_top_k(typo, 5)
+        self.assertTrue(1 < len(results) <= 5)
+        self.assertEqual(best.corrected_string, results[0].corrected_string)
+        self.assertEqual(best.log_prob_sum, results[0].log_prob_sum)
+        self.assertEqual(len(results),
+                         len(set((result.segmented_string, result.corrected_string) for result in results)))
+
+    def test_word_segmentation_bigrams(self):
+        sym_spell = SymSpell(2, 7)
+        sym_spell.load_dictionary(self.dictionary_path, 0, 1)
+        self.assertEqual("nowhere", sym_spell.word_segmentation_bigrams("nowhere").corrected_string)
+        self.assertEqual("the quick brown fox",
+                         sym_spell.word_segmentation_bigrams("thequickbrownfox").corrected_string)
+
+        sym_spell.load_bigram_dictionary(os.path.join(self.fortests_path, "segmentation_bigrams.txt"), 0, 2)
+        self.assertEqual(1000000000, sym_spell.bigram_count("now", "here"))
+        self.assertEqual(0, sym_spell.bigram_count("here", "now"))
+        self.assertEqual("now here", sym_spell.word_segmentation_bigrams("nowhere").corrected_string)
+
     def test_suggest_item(self):
         si_1 = SuggestItem("asdf", 12, 34)
         si_2 = SuggestItem("sdfg", 12, 34)
@@ -559,6 +739,27 @@ class SymSpellCppPyTests(unittest.TestCase):
                          sym_spell_2.lookup("flam", Verbosity.TOP, 0, True)[0].term)
         os.remove(pickle_path)
 
+    def test_load_index_should_map_saved_dictionary(self):
+        index_path = os.path.join(self.fortests_path, "dictionary.index")
+        sym_spell = SymSpell(2, 7)
+        sym_spell.load_dictionary(self.dictionary_path, 0, 1)
+        sym_spell.load_bigram_dictionary(os.path.join(self.fortests_path, "segmentation_bigrams.txt"), 0, 2)
+        sym_spell.save_index(index_path)
+
+        sym_spell_2 = SymSpell(1, 3)
+        sym_spell_2.load_index(index_path)
+        self.assertEqual(sym_spell.max_length(), sym_spell_2.max_length())
+        self.assertEqual(sym_spell.word_count(), sym_spell_2.word_count())
+        self.assertEqual(sym_spell.entry_count(), sym_spell_2.entry_count())
+        for term in ["tke", "abolution", "intermedaite"]:
+            expected = sym_spell.lookup(term, Verbosity.ALL, 2)
+            results = sym_spell_2.lookup(term, Verbosity.ALL, 2)
+            self.assertEqual([(s.term, s.distance, s.count) for s in expected],
+                             [(s.term, s.distance, s.count) for s in results])
+        self.assertEqual(1000000000, sym_spell_2.bigram_count("now", "here"))
+        del sym_spell_2
+        os.remove(index_path)
+
     def test_pickle_bytes(self):
         edit_distance_max = 2
         prefix_length = 7
@@ -602,6 +803,57 @@ class SymSpellCppPyTests(unittest.TestCase):
         self.assertEqual(1, len(result))
         self.assertEqual("steem", result[0].term)
 
+    def test_delete_dictionary_entries(self):
+        sym_spell = SymSpell()
+        sym_spell.create_dictionary_entry("stea", 1)
+        sym_spell.create_dictionary_entry("steama", 2)
+        sym_spell.create_dictionary_entry("steem", 3)
+        entry_count = sym_spell.entry_count()
+
+        self.assertEqual(2, sym_spell.delete_dictionary_entries(["steama", "steem", "steamab"]))
+        self.assertEqual(1, sym_spell.word_count())
+        self.assertEqual(len("stea"), sym_spell.max_length())
+        self.assertLess(sym_spell.entry_count(), entry_count)
+        result = sym_spell.lookup("steama", Verbosity.TOP, 2)
+        self.assertEqual(1, len(result))
+        self.assertEqual("stea", result[0].term)
+
+    def test_lookup_while_deleting_from_other_thread(self):
+        sym_spell = SymSpell(2, 7, frozen_index=True)
+        sym_spell.load_dictionary(self.dictionary_path, 0, 1)
+        toggled = ["abolition", "intermediate", "extrinsic"]
+        queries = ["abolution", "intermedaite", "extrine"]
+        counts = [sym_spell.lookup(word, Verbosity.TOP, 0)[0].count for word in toggled]
+        with_words = [sym_spell.lookup(query, Verbosity.ALL, 2) for query in queries]
+        sym_spell.delete_dictionary_entries(toggled)
+        without_words = [sym_spell.lookup(query, Verbosity.ALL, 2) for query in queries]
+        sym_spell.compact_index()
+        for word, count in zip(toggled, counts):
+            sym_spell.create_dictionary_entry(word, count)
+
+        done = threading.Event()
+        mismatches = []
+
+        def look_up(query, with_results, without_results):
+            while not done.is_set():
+                results = sym_spell.lookup(query, Verbosity.ALL, 2)
+                if results != with_results and results != without_results:
+                    mismatches.append(query)
+
+        threads = [threading.Thread(target=look_up, args=args) for args in zip(queries, with_words, without_words)]
+        for thread in threads:
+            thread.start()
+        for _ in range(10):
+            self.assertEqual(len(toggled), sym_spell.delete_dictionary_entries(toggled))
+            sym_spell.compact_index()
+            for word, count in zip(toggled, counts):
+                self.assertTrue(sym_spell.create_dictionary_entry(word, count))
+        done.set()
+        for thread in threads:
+            thread.join()
+        self.assertEqual([], mismatches)
+        self.assertEqual(with_words, [sym_spell.lookup(query, Verbosity.ALL, 2) for query in queries])
+
     def test_delete_dictionary_entry_invalid_word(self):
         sym_spell = SymSpell()
         sym_spell.create_dictionary_entry("stea", 1)
@@ -736,6 +988,20 @@ class SymSpellCppPyTests(unittest.TestCase):
                                   transfer_casing=True)
         self.assertEqual("I", result[0].term)
 
+    def test_delete_hashers(self):
+        sym_spells = {}
+        for hasher in (DeleteHasher.FNV32, DeleteHasher.FNV64, DeleteHasher.WYHASH):
+            sym_spells[hasher] = SymSpell(2, 7, delete_hasher=hasher)
+            sym_spells[hasher].load_dictionary(self.dictionary_path, 0, 1, " ")
+            self.assertEqual(hasher, sym_spells[hasher].delete_hasher())
+        self.assertLess(sym_spells[DeleteHasher.FNV32].entry_count(), sym_spells[DeleteHasher.WYHASH].entry_count())
+        self.assertEqual(sym_spells[DeleteHasher.FNV64].entry_count(), sym_spells[DeleteHasher.WYHASH].entry_count())
+        expected = [(s.term, s.distance, s.count)
+                    for s in sym_spells[DeleteHasher.FNV32].lookup("abolution", Verbosity.ALL, 2)]
+        for hasher in (DeleteHasher.FNV64, DeleteHasher.WYHASH):
+            results = [(s.term, s.distance, s.count) for s in sym_spells[hasher].lookup("abolution", Verbosity.ALL, 2)]
+            self.assertEqual(expected, results)
+
     def test_empty_deletes(self):
         self.assertEqual(SymSpell(2).lookup("ab", Verbosity.CLOSEST), [])
         self.assertEqual(SymSpell().entry_count(), 0)